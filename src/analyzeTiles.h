@@ -1,213 +1,490 @@
 #pragma once
 
-#include<bitset>
+#include<array>
+#include<charconv>
 #include<cstddef>
+#include<cstdint>
 #include<cstdlib>
-#include<fstream>
 #include<iostream>
+#include<limits>
 #include<string>
+#include<string_view>
 #include<map>
-#include<regex>
+#include<memory>
+#include<system_error>
 #include<unordered_map>
 #include<utility>
 #include<vector>
 
+#include"domain.h"
 #include"globals.h"
+#include"mappedFile.h"
 #include"point.h"
+#include"profile.h"
 #include"utils.h"
 
-// rotatability of current tileset
-bool rotatable{true};
+// Rules of a tileset, read from its data file by analyzeTiles(). Never changed once built, so one
+// instance can be shared by every solver and thread using the tileset
+struct TileRules{
 
-// index lookup for non rotating tilesets
-std::map<std::size_t,std::size_t> nonRotatingIndex;
+   // rotatability of the tileset
+   bool rotatable{true};
 
-// vector of symmetries
-std::vector<std::size_t> symmetryIndex;
+   // index lookup for non rotating tilesets
+   std::map<std::size_t,std::size_t> nonRotatingIndex;
 
-// map of tile index <-> bitset e.g. {0,1}<->[0001]
-std::map<tileState, Bitset> getBitset;
-std::unordered_map<Bitset,tileState> getTile;
+   // vector of symmetries
+   std::vector<std::size_t> symmetryIndex;
 
-// map of tile to left-right connection
-std::unordered_map<Bitset,Bitset> connectsTo;
+   // tile {a,b} <-> tile index e.g. {0,1}<->1
+   std::map<tileState, std::size_t> getIndex;
+   std::vector<tileState> getTile;
 
-// map of rotations (by 90 degrees)
-std::unordered_map<Bitset,Bitset> rightRotation;
-std::unordered_map<Bitset,Bitset> leftRotation;
+   // tiles which can be to the right of each tile
+   std::vector<TileSet> connectsTo;
 
-// vector of weights for each tile 
-std::vector<int> weights;              // original
+   // index of each tile rotated by 90 degrees
+   std::vector<std::size_t> rightRotation;
+   std::vector<std::size_t> leftRotation;
+
+   // compatibility table. compat[i][j] is the set of tiles allowed next to tile j in direction cardinals[i]
+   std::array<std::vector<TileSet>,4> compat;
+
+   // tiles which connect both ways to tile j when placed in direction cardinals[i] of it: in compat[i][j], and
+   // allowing j back (compat[(i+2)%4]). Same as compat on symmetric tilesets, used to match tiles placed beforehand
+   std::array<std::vector<TileSet>,4> mutualCompat;
+
+   // weight of each tile given by the data file
+   std::vector<int> weights;
+
+   // number of unique tiles (including rotations if possible)
+   std::size_t uniqueTiles{0};
+
+   // rotate a unique tile clockwise. n: 0-0deg, 1-90deg, 2-180deg, 3-270deg
+   std::size_t rotate(std::size_t tile, std::size_t n, bool clockwise) const;
+
+   // rotate every tile of a set
+   TileSet rotate(const TileSet& tiles, std::size_t n, bool clockwise) const;
+
+   // precompute connections of every tile in every direction, so propagation never needs rotate()
+   void buildCompat();
+
+   // precompute mutualCompat from compat
+   void buildMutualCompat();
+
+   // whether tile b may be placed in direction cardinals[d] of tile a
+   bool connects(const tileState& a, std::size_t d, const tileState& b) const;
+
+   // same tables
+   bool operator==(const TileRules& other) const = default;
+};
+
+// rules of the tileset shown by the viewer (set by loadTileset)
+std::shared_ptr<const TileRules> tileRules;
+
+// viewer weights of each tile, changed by the menus
 std::vector<int> currentWeights;       // used in current simulation
 std::vector<int> savedWeights;         // weights affected by range buttons
-auto weightSwitch = Bitset{}.set();    // turn tile on/off (use char to avoid bool specialization);
-auto nextWeightSwitch = Bitset{}.set();
+TileSet weightSwitch;                  // turn tile on/off
+TileSet nextWeightSwitch;
+
+// where and why a data file could not be read
+struct TilesetError{
+   std::string path;
+   std::size_t line{0};                 // from 1, 0 if it is about the whole file
+   std::size_t column{0};               // from 1, 0 if it is about the end of the file
+   std::string message;
+
+   // "path:line:column: message"
+   std::string describe() const;
+};
+
+// Single pass reader of a data file held in memory, one line at a time. Numbers are read with
+// std::from_chars straight from the text, and the first problem is recorded with its position.
+struct TilesParser{
 
-// number of unique tiles (including rotations if possible)
-std::size_t uniqueTiles;
+   TilesParser(std::string_view text, TilesetError& error): text(text), error(error){};
 
-// read information on tileset from file
+   // current line without its line end, its number and the read position in it
+   std::string_view line;
+   std::size_t lineNumber{0};
+   std::size_t column{0};
+
+   // move to the next line, false at the end of the text
+   bool nextLine();
+
+   bool atEnd() const { return column >= line.size(); }
+   void skipSpaces();
+
+   // record a problem at position at of the current line, always false
+   bool fail(std::size_t at, std::string message);
+
+   // record a problem with the text ending before the line after the current one, always false
+   bool failAtEnd(std::string message);
+
+   // read c after optional spaces
+   bool expect(char c);
+
+   // read an unsigned number no larger than max
+   bool number(std::size_t& value, std::size_t max);
+
+   // read a list of "{a,b}" separated by commas, calling onPair(a, b, position of '{') for each.
+   // Stops at the first pair not followed by a comma
+   template<typename OnPair>
+   bool pairs(OnPair onPair);
+
+private:
+   std::string_view text;
+   std::size_t next{0};
+   TilesetError& error;
+};
+
+// read information on tileset from a data file held in memory, nullptr with error set if it is malformed
 // tile properties are represented in braket notation int the file {a,b}. a=tile index, b=orientation
-// for fast calculations, this will be converted into a unique bitset for each tile e.g. {0,0}->0001
-void analyzeTiles(){
+// for fast calculations, each tile gets a unique index e.g. {0,1}->1, and sets of tiles are sets of indexes
+std::shared_ptr<const TileRules> parseTiles(std::string_view text, const std::string& path, TilesetError& error){
 
-   std::ifstream dataFile(pathToData());
-   if (!dataFile.is_open()){
-      std::cerr << "Could not open \"" << pathToData() << "\". Exiting.\n";
-      std::exit(EXIT_FAILURE);
-   }
+   WFC_ZONE("parseTiles");
 
-   // regex matching "{a,b}", returning a,b as submatches
-   std::regex tileIndices("\\{(\\d+)\\,(\\d+)\\}");
+   error = TilesetError{path, 0, 0, {}};
+   TilesParser parser(text, error);
 
-   std::string line;
+   auto rules = std::make_shared<TileRules>();
 
-   // check for tileset rotatability
-   std::getline(dataFile,line);
-   if (line.back() == '\r'){ line.pop_back(); }
+   // a line of the header, with the end of the file as error
+   auto headerLine = [&](const char* expected){
+      if (parser.nextLine()){ return true; }
+      return parser.failAtEnd(std::string{"unexpected end of file, expected "} + expected);
+   };
 
-   if (line=="no rotation"){ rotatable = false; }
-   else if (line=="rotate"){ rotatable = true;  }
+   // check for tileset rotatability
+   if (!headerLine("the rotation type")){ return nullptr; }
+   if (parser.line=="no rotation"){ rules->rotatable = false; }
+   else if (parser.line=="rotate"){ rules->rotatable = true; }
    else {
-      std::cerr << "Rotation type could not be found in \"" << pathToData() << "\".\n";
-      std::exit(EXIT_FAILURE);
+      parser.fail(0, "rotation type must be \"rotate\" or \"no rotation\"");
+      return nullptr;
    }
-   std::getline(dataFile,line);
 
-   // create list of tiles in braket {a,b} and bitset (00010) form 
-   std::size_t id{ 0 }, index{0};
-   std::getline(dataFile,line);
-   if (line.back() == '\r'){ line.pop_back(); }
+   if (!headerLine("an empty line")){ return nullptr; }
+   if (!parser.line.empty()){
+      parser.fail(0, "expected an empty line");
+      return nullptr;
+   }
+
+   // create list of tiles in braket {a,b} and index form, a=tile symmetry, b=tile weight
+   if (!headerLine("the list of tiles")){ return nullptr; }
+   std::size_t id{0}, index{0};
 
-   // use regex to get each {a,b} a=tile symmetry, b=tile weight
-   auto begin = std::sregex_iterator(line.begin(), line.end(), tileIndices);
-   auto end   = std::sregex_iterator();
+   // index of the first orientation of each tile id, for the lookups below
+   std::vector<std::size_t> firstIndex;
 
-   for (std::sregex_iterator i=begin; i!=end; ++i){
-      
-      std::vector<tileState> brackets{{id,0},{id,1},{id,2},{id,3}};
-      std::vector<Bitset> bits{Bitset{}.set(index), Bitset{}.set(index+1),Bitset{}.set(index+2),Bitset{}.set(index+3)};
-      
-      // get symmetry {Sym,_}
-      std::size_t symmetry = std::stoull(i->str(1));
+   bool read = parser.pairs([&](std::size_t symmetry, std::size_t weight, std::size_t at){
+      if (symmetry!=1 && symmetry!=2 && symmetry!=4){ return parser.fail(at, "symmetry must be 1, 2 or 4"); }
+      if (weight > static_cast<std::size_t>(std::numeric_limits<int>::max())){ return parser.fail(at, "weight is too large"); }
 
       // save index of unique tiles ignoring rotations
-      nonRotatingIndex[id] = index;
+      rules->nonRotatingIndex.emplace_hint(rules->nonRotatingIndex.end(), id, index);
+      firstIndex.push_back(index);
 
       for (std::size_t j=0; j<symmetry; j++){
-         
-         // create maps from tileState<->bitset
-         getBitset[brackets[j]] = bits[j];
-         getTile[bits[j]] = brackets[j];
+
+         // create maps from tileState<->index
+         rules->getIndex.emplace_hint(rules->getIndex.end(), tileState{id,j}, index+j);
+         rules->getTile.push_back({id,j});
 
          // create maps for right and left rotations
-         rightRotation[bits[j]] = bits[(j+1)%symmetry];
-         leftRotation[bits[(j+1)%symmetry]] = bits[j];
+         rules->rightRotation.push_back(index + (j+1)%symmetry);
+         rules->leftRotation.push_back(index + (j+symmetry-1)%symmetry);
 
          // fill weights for each unique tile
-         weights.push_back(std::stoi(i->str(2)));
+         rules->weights.push_back(static_cast<int>(weight));
       }
 
       id++;
       index += symmetry;
-      symmetryIndex.push_back(symmetry);
+      rules->symmetryIndex.push_back(symmetry);
+      return true;
+   });
+   if (!read){ return nullptr; }
+   if (!parser.atEnd()){
+      parser.fail(parser.column, "expected ','");
+      return nullptr;
+   }
+
+   if (!headerLine("an empty line")){ return nullptr; }
+   if (!parser.line.empty()){
+      parser.fail(0, "expected an empty line");
+      return nullptr;
    }
-   std::getline(dataFile, line);
 
    // set n unique Tiles
-   uniqueTiles = index;
+   rules->uniqueTiles = index;
 
-   // copy weights over
-   currentWeights = weights;
-   savedWeights   = weights;
+   // index of tile {a,b} read at position at, set unless it is not in the list of tiles
+   std::size_t tile{0};
+   auto indexOf = [&](std::size_t a, std::size_t b, std::size_t at){
+      if (a >= rules->symmetryIndex.size() || b >= rules->symmetryIndex[a]){
+         return parser.fail(at, "unknown tile {" + std::to_string(a) + "," + std::to_string(b) + "}");
+      }
+      tile = firstIndex[a] + b;
+      return true;
+   };
 
-   // keep track of connection names for next part
-   std::unordered_map<std::string, Bitset> connectionBitset; 
+   // part [from, to) of the line without spaces around it, and where it starts
+   auto readName = [&](std::size_t from, std::size_t to){
+      while (from < to && (parser.line[from]==' ' || parser.line[from]=='\t')){ from++; }
+      while (to > from && (parser.line[to-1]==' ' || parser.line[to-1]=='\t')){ to--; }
+      return std::pair{parser.line.substr(from, to-from), from};
+   };
 
-   // create bitsets for named connections
-   while (std::getline(dataFile,line)){
-      if (!line.empty() && line.back() == '\r'){ line.pop_back(); }
+   // create sets of tiles for named connections, "name - {a,b},..." until an empty line.
+   // Names point into text, which outlives them
+   std::unordered_map<std::string_view, TileSet> connectionTiles;
 
-      // stop at empty line
-      if (line.empty()){ break; }
+   while (parser.nextLine() && !parser.line.empty()){
 
       // get name of connection
-      std::size_t pos = line.find('-');
-      std::string name  = line.substr(0,pos-1);
-
-      // read connections in bracket notation
-      std::vector<Bitset> connection, rotation;
+      std::size_t dash = parser.line.find('-');
+      if (dash == std::string_view::npos){
+         parser.fail(0, "expected \"name - {a,b},...\"");
+         return nullptr;
+      }
 
-      // use regex to get each unique tile
-      // get matches from beginning to end of line 
-      begin = std::sregex_iterator(line.begin(), line.end(), tileIndices);
-      end   = std::sregex_iterator();
+      auto [name, nameAt] = readName(0, dash);
+      if (name.empty()){
+         parser.fail(nameAt, "missing connection name");
+         return nullptr;
+      }
 
-      for (std::sregex_iterator i=begin; i!=end; ++i){
-         connection.push_back(getBitset[{std::stoull(i->str(1)),std::stoull(i->str(2))}]);
+      TileSet tiles(rules->uniqueTiles);
+      parser.column = dash + 1;
+      read = parser.pairs([&](std::size_t a, std::size_t b, std::size_t at){
+         if (!indexOf(a, b, at)){ return false; }
+         tiles.set(tile);
+         return true;
+      });
+      if (!read){ return nullptr; }
+      if (!parser.atEnd()){
+         parser.fail(parser.column, "expected ','");
+         return nullptr;
       }
 
-      // create bitset for connection
-      Bitset bits;
-      for (const auto& tile : connection){ bits |= tile; }
-      connectionBitset[name] = bits;
-
-      // calculate rotations
-      rotation = connection;
-      for (int i=0; i<4; i++){
-        
-         Bitset copyBits, rotationBits;
-         for (auto& tile : rotation){
-            copyBits |= tile;
-            tile = rightRotation[tile];
-            rotationBits |= tile;
-         }
-
-         rightRotation[copyBits] = rotationBits;
-         leftRotation[rotationBits] = copyBits;
-
-         // stop early for connections with symmetry < 4
-         if (bits==rotationBits){ break; }
+      if (!connectionTiles.emplace(name, std::move(tiles)).second){
+         parser.fail(nameAt, "connection \"" + std::string{name} + "\" is defined twice");
+         return nullptr;
       }
    }
 
-   // finally get leftright connections for each tile
-   while (getline(dataFile,line)){
-      if (!line.empty() && line.back() == '\r'){ line.pop_back(); }
+   rules->connectsTo.assign(rules->uniqueTiles, TileSet(rules->uniqueTiles));
 
-      // stop at empty line
-      if (line.empty()){ break; }
+   // finally get leftright connections for each tile, "{a,b},... - name" until an empty line
+   while (parser.nextLine() && !parser.line.empty()){
+
+      // tiles are connected once the name is known
+      std::vector<std::size_t> tiles;
+      read = parser.pairs([&](std::size_t a, std::size_t b, std::size_t at){
+         if (!indexOf(a, b, at)){ return false; }
+         tiles.push_back(tile);
+         return true;
+      });
+      if (!read || !parser.expect('-')){ return nullptr; }
 
       // read connection name on right
-      std::size_t pos = line.find('-');
-      std::string name  = line.substr(pos+2);
-
-      // use regex to iterate through lines with multiple unique tiles on left
-      begin = std::sregex_iterator(line.begin(), line.end(), tileIndices);
-      end   = std::sregex_iterator();
-
-      for (std::sregex_iterator i=begin; i!=end; ++i){
-         if (!connectionBitset.contains(name)){
-            std::cerr << "Name problem\n";
-            std::exit(EXIT_FAILURE);
-         }
-         
-         Bitset bits = getBitset[{std::stoull(i->str(1)),std::stoull(i->str(2))}];
-         connectsTo[bits] = connectionBitset[name];
+      auto [name, nameAt] = readName(parser.column, parser.line.size());
+      auto connection = connectionTiles.find(name);
+      if (connection == connectionTiles.end()){
+         parser.fail(nameAt, "unknown connection \"" + std::string{name} + "\"");
+         return nullptr;
+      }
+
+      for (std::size_t t : tiles){ rules->connectsTo[t] = connection->second; }
+   }
+
+   // only empty lines may follow
+   while (parser.nextLine()){
+      if (!parser.line.empty()){
+         parser.fail(0, "unexpected text after the rules");
+         return nullptr;
       }
    }
+
+   rules->buildCompat();
+
+   return rules;
+}
+
+// read a tileset's data file, nullptr with error set if it can't be read or is malformed
+std::shared_ptr<const TileRules> parseTiles(const std::string& path, TilesetError& error){
+
+   MappedFile file(path);
+   if (!file.open){
+      error = TilesetError{path, 0, 0, "could not open the file"};
+      return nullptr;
+   }
+
+   return parseTiles(std::string_view{file.data, file.size}, path, error);
+}
+
+// read a tileset's data file, exits with the error if it can't be read or is malformed
+std::shared_ptr<const TileRules> analyzeTiles(const std::string& path=pathToData()){
+
+   TilesetError error;
+   std::shared_ptr<const TileRules> rules = parseTiles(path, error);
+
+   if (!rules){
+      std::cerr << error.describe() << "\n";
+      std::exit(EXIT_FAILURE);
+   }
+
+   return rules;
 }
 
-// rotate a unique tile clockwise. n: 0-0deg, 1-90deg, 2-180deg, 3-270deg
-void rotate(Bitset& tile, std::size_t n, bool clockwise){
+// show a tileset in the viewer, every tile enabled at its own weight
+const std::shared_ptr<const TileRules>& loadTileset(std::shared_ptr<const TileRules> rules){
+
+   tileRules = std::move(rules);
+
+   currentWeights   = tileRules->weights;
+   savedWeights     = tileRules->weights;
+   weightSwitch     = TileSet(tileRules->uniqueTiles, true);
+   nextWeightSwitch = TileSet(tileRules->uniqueTiles, true);
+
+   return tileRules;
+}
+
+std::size_t TileRules::rotate(std::size_t tile, std::size_t n, bool clockwise) const {
    switch (n){
-   case 0: break;
-   case 1: tile = clockwise ? rightRotation[tile] : leftRotation[tile]; break;
-   case 2: tile = leftRotation[leftRotation[tile]]; break;
-   case 3: tile = clockwise ? leftRotation[tile] : rightRotation[tile]; break;
+   case 0: return tile;
+   case 1: return clockwise ? rightRotation[tile] : leftRotation[tile];
+   case 2: return leftRotation[leftRotation[tile]];
+   case 3: return clockwise ? leftRotation[tile] : rightRotation[tile];
    default:
       std::cerr << "Invalid rotation\n";
       std::exit(EXIT_FAILURE);
    }
 }
 
+TileSet TileRules::rotate(const TileSet& tiles, std::size_t n, bool clockwise) const {
+   TileSet rotated(uniqueTiles);
+   tiles.forEach([&](std::size_t tile){ rotated.set(rotate(tile, n, clockwise)); });
+   return rotated;
+}
+
+void TileRules::buildCompat(){
+
+   for (std::size_t i=0; i<4; i++){
+
+      compat[i].assign(uniqueTiles, TileSet(uniqueTiles));
+
+      for (std::size_t j=0; j<uniqueTiles; j++){
+
+         // rotate current tile so that we can look up left<->right connections,
+         // then rotate its connections back to original orientation
+         compat[i][j] = rotate(connectsTo[rotate(j, i, dir::anticlockwise)], i, dir::clockwise);
+      }
+   }
+
+   buildMutualCompat();
+}
+
+void TileRules::buildMutualCompat(){
+
+   for (std::size_t i=0; i<4; i++){
+
+      mutualCompat[i].assign(uniqueTiles, TileSet(uniqueTiles));
+
+      for (std::size_t j=0; j<uniqueTiles; j++){
+         compat[i][j].forEach([&](std::size_t t){ if (compat[(i+2)%4][t].test(j)){ mutualCompat[i][j].set(t); } });
+      }
+   }
+}
+
+bool TileRules::connects(const tileState& a, std::size_t d, const tileState& b) const {
+   return mutualCompat[d][getIndex.at(a)].test(getIndex.at(b));
+}
+
+std::string TilesetError::describe() const {
+
+   std::string text = path;
+   for (std::size_t number : {line, column}){
+      if (number == 0){ break; }
+      text.append(":").append(std::to_string(number));
+   }
+   return text.append(": ").append(message);
+}
+
+bool TilesParser::nextLine(){
+
+   if (next >= text.size()){ return false; }
+
+   std::size_t end = text.find('\n', next);
+   if (end == std::string_view::npos){ end = text.size(); }
+
+   line = text.substr(next, end-next);
+   if (!line.empty() && line.back() == '\r'){ line.remove_suffix(1); }
+
+   next = end + 1;
+   lineNumber++;
+   column = 0;
+   return true;
+}
+
+void TilesParser::skipSpaces(){
+   while (column < line.size() && (line[column]==' ' || line[column]=='\t')){ column++; }
+}
+
+bool TilesParser::fail(std::size_t at, std::string message){
+   error.line = lineNumber;
+   error.column = at + 1;
+   error.message = std::move(message);
+   return false;
+}
+
+bool TilesParser::failAtEnd(std::string message){
+   error.line = lineNumber + 1;
+   error.column = 0;
+   error.message = std::move(message);
+   return false;
+}
+
+bool TilesParser::expect(char c){
+
+   skipSpaces();
+   if (atEnd() || line[column] != c){ return fail(column, std::string{"expected '"} + c + "'"); }
+
+   column++;
+   return true;
+}
+
+bool TilesParser::number(std::size_t& value, std::size_t max){
+
+   skipSpaces();
+   auto [end, status] = std::from_chars(line.data() + column, line.data() + line.size(), value);
+
+   if (status == std::errc::invalid_argument){ return fail(column, "expected a number"); }
+   if (status == std::errc::result_out_of_range || value > max){ return fail(column, "number is too large"); }
+
+   column = static_cast<std::size_t>(end - line.data());
+   return true;
+}
+
+template<typename OnPair>
+bool TilesParser::pairs(OnPair onPair){
+
+   // no index or weight is anywhere near this, and sums of them can't overflow
+   constexpr std::size_t max{std::numeric_limits<std::uint32_t>::max()};
+
+   while (true){
+
+      skipSpaces();
+      std::size_t at = column;
+      std::size_t a, b;
+      if (!expect('{') || !number(a, max) || !expect(',') || !number(b, max) || !expect('}')){ return false; }
+      if (!onPair(a, b, at)){ return false; }
+
+      skipSpaces();
+      if (atEnd() || line[column] != ','){ return true; }
+      column++;
+   }
+}
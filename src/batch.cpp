@@ -0,0 +1,291 @@
+#include<chrono>
+#include<cstddef>
+#include<cstdlib>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<memory>
+#include<string>
+#include<string_view>
+#include<thread>
+#include<tuple>
+
+#include"analyzeTiles.h"
+#include"batch.h"
+#include"compiledTiles.h"
+#include"config.h"
+#include"globals.h"
+#include"pool.h"
+#include"profile.h"
+#include"solver.h"
+#include"tiled.h"
+#include"utils.h"
+
+// command line options for batch generation
+struct BatchOptions{
+    std::string tileset{"circuit"};
+    int width{gridWidth};
+    int height{gridHeight};
+    unsigned long long firstSeed{0};
+    unsigned long long count{100};
+    std::size_t maxAttempts{1000};
+    std::size_t maxBacktracks{::maxBacktracks};
+    Propagation propagation{Propagation::bitset};
+    Heuristic heuristic{Heuristic::count};
+    std::filesystem::path outDir{"output"};
+    bool write{true};
+    bool allowSeams{false};                                            // keep tiled maps whose seams don't all connect
+    int pieceWidth{0};                                                 // whole map at once when 0
+    int pieceHeight{0};
+    std::size_t threads{std::thread::hardware_concurrency()};
+    std::filesystem::path profile{};                                   // no trace when empty
+};
+
+void printUsage(){
+    std::cout << "Usage: wfc_batch [options]\n"
+              << "  --tileset NAME       tileset directory in tilesets/ (default circuit)\n"
+              << "  --size WxH           grid size in cells (default " << gridWidth << "x" << gridHeight << ")\n"
+              << "  --seeds FIRST-LAST   inclusive seed range (default 0-99)\n"
+              << "  --propagation TYPE   bitset or support (AC-4) propagation engine (default bitset)\n"
+              << "  --heuristic TYPE     count or entropy (weighted Shannon) choice of next tile (default count)\n"
+              << "  --attempts N         restarts allowed per seed on contradiction (default 1000)\n"
+              << "  --backtracks N       undone collapses allowed per attempt before restarting (default " << maxBacktracks << ", 0 disables)\n"
+              << "  --piece WxH          solve each map in pieces of WxH cells on several threads (default whole map)\n"
+              << "  --threads N          threads solving maps, or pieces with --piece (default: one per core)\n"
+              << "  --out DIR            output directory (default output)\n"
+              << "  --no-write           only generate, do not write maps to disk\n"
+              << "  --allow-seams        with --piece, keep maps whose pieces could not all be connected (counted as failures otherwise)\n"
+              << "  --profile FILE       write a Chrome trace of the solver to FILE and print its zones and counters (WFC_PROFILE builds)\n";
+}
+
+// parse command line, exits on bad input
+BatchOptions parseOptions(int argc, char* argv[]){
+
+    BatchOptions options;
+
+    for (int i=1; i<argc; i++){
+        std::string_view arg{argv[i]};
+
+        // options which take a value
+        auto value = [&]() -> std::string {
+            if (i+1 >= argc){
+                std::cerr << "Missing value for \"" << arg << "\".\n";
+                std::exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+
+        try {
+            if (arg=="--tileset"){ options.tileset = value(); }
+            else if (arg=="--size"){
+                std::string size = value();
+                std::size_t pos = size.find('x');
+                options.width  = std::stoi(size.substr(0,pos));
+                options.height = std::stoi(size.substr(pos+1));
+            }
+            else if (arg=="--seeds"){
+                std::string seeds = value();
+                std::size_t pos = seeds.find('-');
+                options.firstSeed = std::stoull(seeds.substr(0,pos));
+                unsigned long long lastSeed = pos==std::string::npos ? options.firstSeed : std::stoull(seeds.substr(pos+1));
+                if (lastSeed < options.firstSeed){ throw std::invalid_argument("seed range"); }
+                options.count = lastSeed - options.firstSeed + 1;
+            }
+            else if (arg=="--propagation"){
+                std::string type = value();
+                if (type=="bitset"){ options.propagation = Propagation::bitset; }
+                else if (type=="support"){ options.propagation = Propagation::support; }
+                else { throw std::invalid_argument("propagation"); }
+            }
+            else if (arg=="--heuristic"){
+                std::string type = value();
+                if (type=="count"){ options.heuristic = Heuristic::count; }
+                else if (type=="entropy"){ options.heuristic = Heuristic::entropy; }
+                else { throw std::invalid_argument("heuristic"); }
+            }
+            else if (arg=="--attempts"){ options.maxAttempts = std::stoull(value()); }
+            else if (arg=="--backtracks"){ options.maxBacktracks = std::stoull(value()); }
+            else if (arg=="--piece"){ std::tie(options.pieceWidth, options.pieceHeight) = parseSize(value()); }
+            else if (arg=="--threads"){ options.threads = std::stoull(value()); }
+            else if (arg=="--out"){ options.outDir = value(); }
+            else if (arg=="--no-write"){ options.write = false; }
+            else if (arg=="--allow-seams"){ options.allowSeams = true; }
+            else if (arg=="--profile"){ options.profile = value(); }
+            else if (arg=="--help" || arg=="-h"){
+                printUsage();
+                std::exit(EXIT_SUCCESS);
+            }
+            else {
+                std::cerr << "Unknown option \"" << arg << "\".\n";
+                printUsage();
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        catch (const std::logic_error&){
+            std::cerr << "Invalid value for \"" << arg << "\".\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if (options.width<=0 || options.height<=0 || options.pieceWidth<0 || options.pieceHeight<0){
+        std::cerr << "Grid and piece size must be positive.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (!options.profile.empty() && !profiling){
+        std::cerr << "Profiling is not built in, configure with -DWFC_PROFILE=ON.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    return options;
+}
+
+// write collapsed grid (Solver or TiledMap) in bracket notation {a,b}, one row per line
+template<typename Map>
+void writeMap(const std::filesystem::path& path, const Map& map){
+
+    std::ofstream file(path);
+    if (!file.is_open()){
+        std::cerr << "Could not open \"" << path.string() << "\" for writing.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    for (int y=0; y<map.height; y++){
+        for (int x=0; x<map.width; x++){
+            tileState tile = map.tileAt(x,y);
+            file << (x ? ",{" : "{") << tile.x << "," << tile.y << "}";
+        }
+        file << "\n";
+    }
+}
+
+// totals over every map of a batch
+struct BatchStats{
+    std::size_t contradictions{0};
+    std::size_t restarts{0};
+    std::size_t backtracks{0};
+    std::size_t failures{0};
+    std::size_t unmatched{0};                                          // tiles across piece seams which don't connect
+    std::size_t repairs{0};
+    std::size_t memory{0};                                             // bytes of solvers and maps in flight
+};
+
+// output file of a seed
+std::filesystem::path mapPath(const BatchOptions& options, const std::filesystem::path& outDir, unsigned long long seed){
+    return outDir / (options.tileset + "_" + std::to_string(seed) + ".txt");
+}
+
+// solve whole maps in parallel, one per worker, written in seed order
+void generateWhole(const BatchOptions& options, const std::shared_ptr<const TileRules>& rules, const std::filesystem::path& outDir, BatchStats& stats){
+
+    ThreadPool pool(options.threads);
+    BatchGenerator generator(rules, pool, options.width, options.height, options.propagation, options.heuristic, options.maxBacktracks);
+    generator.maxAttempts = options.maxAttempts;
+
+    generator.generate(options.firstSeed, options.count, [&](const BatchMap& map){
+
+        stats.contradictions += map.contradictions;
+        stats.restarts += map.restarts;
+        stats.backtracks += map.backtracks;
+
+        if (!map.solved){
+            std::cerr << "Seed " << map.seed << " could not be collapsed in " << options.maxAttempts << " attempts.\n";
+            stats.failures++;
+            return;
+        }
+
+        if (options.write){ writeMap(mapPath(options, outDir, map.seed), map); }
+    });
+
+    stats.memory = generator.memory();
+}
+
+// solve the pieces of each map in parallel, maps one after the other
+void generateTiled(const BatchOptions& options, const std::shared_ptr<const TileRules>& rules, const std::filesystem::path& outDir, BatchStats& stats){
+
+    ThreadPool pool(options.threads);
+    TiledGenerator generator(rules, pool, options.propagation, options.heuristic, options.maxBacktracks);
+    generator.maxAttempts = options.maxAttempts;
+    TiledMap map(options.width, options.height, options.pieceWidth, options.pieceHeight);
+
+    for (unsigned long long seed=options.firstSeed; seed<options.firstSeed+options.count; seed++){
+
+        generator.generate(map, seed);
+        stats.contradictions += map.contradictions;
+        stats.restarts += map.restarts;
+        stats.backtracks += map.backtracks;
+        stats.unmatched += map.unmatched;
+        stats.repairs += map.repairs;
+
+        if (!map.solved){
+            std::cerr << "Seed " << seed << " has a piece which could not be collapsed in " << options.maxAttempts << " attempts.\n";
+            stats.failures++;
+            continue;
+        }
+
+        if (map.unmatched > 0 && !options.allowSeams){
+            std::cerr << "Seed " << seed << " has " << map.unmatched << " tiles across piece seams which could not be connected.\n";
+            stats.failures++;
+            continue;
+        }
+
+        if (options.write){ writeMap(mapPath(options, outDir, seed), map); }
+    }
+}
+
+int main(int argc, char* argv[]){
+
+    BatchOptions options = parseOptions(argc, argv);
+
+    // output paths are relative to where we were called from, tilesets to the project root
+    std::filesystem::path outDir = std::filesystem::absolute(options.outDir);
+    std::filesystem::path profilePath = options.profile.empty() ? options.profile : std::filesystem::absolute(options.profile);
+    std::filesystem::current_path(rootPath);
+    tilesetDir = options.tileset;
+
+    if (options.write){ std::filesystem::create_directories(outDir); }
+
+    // analyze tileset, shared by every solver
+    std::shared_ptr<const TileRules> rules = loadRules();
+
+    BatchStats stats;
+    bool tiled = options.pieceWidth > 0 && options.pieceHeight > 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (tiled){ generateTiled(options, rules, outDir, stats); }
+    else { generateWhole(options, rules, outDir, stats); }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double generated = static_cast<double>(options.count - stats.failures);
+
+    std::cout << "tileset:        " << options.tileset << "\n"
+              << "propagation:    " << (options.propagation==Propagation::support ? "support" : "bitset") << "\n"
+              << "heuristic:      " << (options.heuristic==Heuristic::entropy ? "entropy" : "count") << "\n"
+              << "size:           " << options.width << "x" << options.height << "\n";
+    if (tiled){
+        std::cout << "pieces:         " << options.pieceWidth << "x" << options.pieceHeight << "\n"
+                  << "repairs:        " << stats.repairs << "\n"
+                  << "unmatched:      " << stats.unmatched << "\n";
+    }
+    else {
+        std::cout << "solver memory:  " << stats.memory/1024 << " KiB\n";
+    }
+    std::cout << "threads:        " << options.threads << "\n";
+    std::cout << "maps:           " << options.count - stats.failures << "/" << options.count << "\n"
+              << "contradictions: " << stats.contradictions << "\n"
+              << "restarts:       " << stats.restarts << "\n"
+              << "backtracks:     " << stats.backtracks << "\n"
+              << "time (s):       " << elapsed.count() << "\n"
+              << "maps/sec:       " << (elapsed.count() > 0.0 ? generated/elapsed.count() : 0.0) << "\n";
+
+    if (!profilePath.empty()){
+        std::cout << "\n";
+        if (!writeProfile(profilePath.string(), std::cout)){
+            std::cerr << "Could not write \"" << profilePath.string() << "\".\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    return stats.failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include<algorithm>
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<utility>
+#include<vector>
+
+#include"analyzeTiles.h"
+#include"globals.h"
+#include"point.h"
+#include"pool.h"
+#include"profile.h"
+#include"solver.h"
+
+// one map of a batch
+struct BatchMap{
+   std::uint64_t seed{0};
+
+   int width{0};
+   int height{0};
+
+   // collapsed tiles, row by row (left as they were if the map could not be solved)
+   std::vector<tileState> tiles;
+
+   // restarts and undone decisions it took
+   std::size_t restarts{0};
+   std::size_t backtracks{0};
+
+   // tiles which ran out of possibilities, also the ones backtracking recovered from
+   std::size_t contradictions{0};
+
+   bool solved{false};
+
+   tileState tileAt(int x, int y) const { return tiles[static_cast<std::size_t>(y)*static_cast<std::size_t>(width) + static_cast<std::size_t>(x)]; }
+};
+
+// Generates independent maps of one tileset from a range of seeds on a pool. Every worker owns a
+// solver (wave, buffers and random generator), only the rules are shared. Maps are handed out in
+// seed order on the calling thread, and at most `window` per worker are kept at once, so memory
+// does not grow with the number of seeds. A map only depends on its seed, the same as Solver::seed.
+struct BatchGenerator{
+
+   // rules shared by every solver
+   std::shared_ptr<const TileRules> rules;
+
+   ThreadPool& pool;
+
+   // map size
+   int width;
+   int height;
+
+   // restarts allowed per seed on contradiction
+   std::size_t maxAttempts{1000};
+
+   // maps solved or waiting to be handed out at once, per worker
+   std::size_t window{4};
+
+   // one solver per worker of pool
+   BatchGenerator(std::shared_ptr<const TileRules> rules, ThreadPool& pool, int width, int height, Propagation propagation=Propagation::bitset,
+                  Heuristic heuristic=Heuristic::count, std::size_t backtrackLimit=maxBacktracks);
+
+   // solve seeds first to first+count-1, calling onMap with each map in seed order
+   void generate(std::uint64_t first, std::uint64_t count, const std::function<void(const BatchMap&)>& onMap);
+
+   // bytes reserved by the solvers and maps
+   std::size_t memory() const;
+
+private:
+
+   std::vector<std::unique_ptr<Solver>> solvers;
+
+   // maps in flight, seed s in slot s%slots.size(), and which of them are solved
+   std::vector<BatchMap> slots;
+   std::vector<bool> ready;
+
+   // guards ready, signalled when a map is solved
+   std::mutex mutex;
+   std::condition_variable solved;
+
+   // solve a map with the solver of worker
+   void solve(BatchMap& map, std::size_t worker);
+};
+
+BatchGenerator::BatchGenerator(std::shared_ptr<const TileRules> rules, ThreadPool& pool, int width, int height, Propagation propagation,
+                               Heuristic heuristic, std::size_t backtrackLimit):
+   rules(std::move(rules)), pool(pool), width(width), height(height){
+
+   // created here, the constructor draws from the global generator which is not thread safe
+   for (std::size_t i=0; i<pool.size(); i++){
+      solvers.push_back(makeSolver(this->rules, width, height, propagation, heuristic, backtrackLimit));
+   }
+}
+
+void BatchGenerator::generate(std::uint64_t first, std::uint64_t count, const std::function<void(const BatchMap&)>& onMap){
+
+   slots.resize(pool.size()*std::max<std::size_t>(window, 1));
+   ready.assign(slots.size(), false);
+
+   std::uint64_t end = first + count, next = first;
+
+   for (std::uint64_t seed=first; seed<end; seed++){
+
+      // keep the window full, a slot is free once the map before it was handed out
+      for (; next<end && next<seed+slots.size(); next++){
+         BatchMap& map = slots[next%slots.size()];
+         map.seed = next;
+         map.width = width;
+         map.height = height;
+         pool.submit([this, &map](std::size_t worker){ solve(map, worker); });
+      }
+
+      std::size_t slot = seed%slots.size();
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         solved.wait(lock, [&]{ return ready[slot]; });
+         ready[slot] = false;
+      }
+
+      onMap(slots[slot]);
+   }
+}
+
+void BatchGenerator::solve(BatchMap& map, std::size_t worker){
+
+   WFC_ZONE("BatchGenerator::solve");
+
+   Solver& solver = *solvers[worker];
+
+   // same seed, tileset and size always give the same map
+   solver.seed(map.seed);
+   map.restarts = 0;
+   map.backtracks = 0;
+   map.solved = false;
+   std::uint64_t contradictions = solver.totalContradictions;
+
+   // restart on contradiction until solved or out of attempts
+   for (std::size_t attempt=0; attempt<maxAttempts && !map.solved; attempt++){
+      map.solved = solver.solve();
+      map.backtracks += solver.backtracks;
+      if (!map.solved){
+         map.restarts++;
+         solver.reset();
+      }
+   }
+   map.contradictions = static_cast<std::size_t>(solver.totalContradictions - contradictions);
+
+   // the slot's buffer is reused by the maps after it
+   if (map.solved){
+      map.tiles.resize(solver.size());
+      for (int y=0; y<height; y++){
+         for (int x=0; x<width; x++){ map.tiles[static_cast<std::size_t>(y*width + x)] = solver.tileAt(x,y); }
+      }
+   }
+
+   // notified under the lock, the generator may be destroyed as soon as the last map is handed out
+   std::lock_guard<std::mutex> lock(mutex);
+   ready[map.seed%slots.size()] = true;
+   solved.notify_all();
+}
+
+std::size_t BatchGenerator::memory() const {
+
+   std::size_t bytes{0};
+   for (const auto& solver : solvers){ bytes += solver->memory(); }
+   for (const BatchMap& map : slots){ bytes += map.tiles.capacity()*sizeof(tileState); }
+   return bytes;
+}
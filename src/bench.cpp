@@ -0,0 +1,604 @@
+#include<algorithm>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<cstdlib>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<memory>
+#include<regex>
+#include<sstream>
+#include<string>
+#include<string_view>
+#include<unordered_map>
+#include<utility>
+#include<vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include<sys/resource.h>
+#endif
+
+#include"analyzeTiles.h"
+#include"compiledTiles.h"
+#include"config.h"
+#include"globals.h"
+#include"profile.h"
+#include"random.h"
+#include"solver.h"
+#include"utils.h"
+
+using Clock = std::chrono::steady_clock;
+
+// command line options for the benchmark
+struct BenchOptions{
+    std::vector<std::string> tilesets;                                 // all of tilesets/ when empty
+    std::vector<std::pair<int,int>> sizes{{16,16},{32,32},{64,64}};
+    unsigned long long seeds{20};
+    std::size_t repeats{20};
+    std::vector<Propagation> propagations{Propagation::bitset, Propagation::support};
+    Heuristic heuristic{Heuristic::count};
+    std::size_t maxAttempts{1000};
+    std::vector<std::size_t> parseIds;                                 // tile ids of the generated tilesets parsed, none when empty
+    std::filesystem::path out{};                                       // stdout when empty
+    std::filesystem::path profile{};                                   // no trace when empty
+};
+
+void printUsage(){
+    std::cout << "Usage: wfc_bench [options]\n"
+              << "  --tilesets A,B,...   tilesets to run (default all in tilesets/)\n"
+              << "  --sizes WxH,...      grid sizes of the full solves (default 16x16,32x32,64x64)\n"
+              << "  --seeds N            solves per size, seeds 0 to N-1 (default 20)\n"
+              << "  --repeats N          runs of the parsers, compiled loading and reset (default 20)\n"
+              << "  --propagation TYPE   bitset, support or both (default both)\n"
+              << "  --heuristic TYPE     count or entropy (default count)\n"
+              << "  --kernel TYPE        union kernel of bitset propagation: auto (widest the CPU supports) or scalar (default auto)\n"
+              << "  --parse-ids N,...    also compare the parsers on generated tilesets of N tile ids, thousands of rules each (e.g. 1000,4000)\n"
+              << "  --out FILE           write the JSON report to FILE instead of stdout\n"
+              << "  --profile FILE       write a Chrome trace of the solver to FILE and print its zones and counters to stderr (WFC_PROFILE builds)\n";
+}
+
+// split "a,b,c"
+std::vector<std::string> split(const std::string& list){
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');){
+        if (!item.empty()){ items.push_back(item); }
+    }
+    return items;
+}
+
+// parse command line, exits on bad input
+BenchOptions parseOptions(int argc, char* argv[]){
+
+    BenchOptions options;
+
+    for (int i=1; i<argc; i++){
+        std::string_view arg{argv[i]};
+
+        // options which take a value
+        auto value = [&]() -> std::string {
+            if (i+1 >= argc){
+                std::cerr << "Missing value for \"" << arg << "\".\n";
+                std::exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+
+        try {
+            if (arg=="--tilesets"){ options.tilesets = split(value()); }
+            else if (arg=="--sizes"){
+                options.sizes.clear();
+                for (const std::string& size : split(value())){ options.sizes.push_back(parseSize(size)); }
+            }
+            else if (arg=="--seeds"){ options.seeds = std::stoull(value()); }
+            else if (arg=="--repeats"){ options.repeats = std::stoull(value()); }
+            else if (arg=="--propagation"){
+                std::string type = value();
+                if (type=="bitset"){ options.propagations = {Propagation::bitset}; }
+                else if (type=="support"){ options.propagations = {Propagation::support}; }
+                else if (type=="both"){ options.propagations = {Propagation::bitset, Propagation::support}; }
+                else { throw std::invalid_argument("propagation"); }
+            }
+            else if (arg=="--heuristic"){
+                std::string type = value();
+                if (type=="count"){ options.heuristic = Heuristic::count; }
+                else if (type=="entropy"){ options.heuristic = Heuristic::entropy; }
+                else { throw std::invalid_argument("heuristic"); }
+            }
+            else if (arg=="--kernel"){
+                std::string type = value();
+                if (type=="scalar"){ unionKernel = unionScalar; }
+                else if (type!="auto"){ throw std::invalid_argument("kernel"); }
+            }
+            else if (arg=="--parse-ids"){
+                for (const std::string& ids : split(value())){ options.parseIds.push_back(std::stoull(ids)); }
+            }
+            else if (arg=="--out"){ options.out = value(); }
+            else if (arg=="--profile"){ options.profile = value(); }
+            else if (arg=="--help" || arg=="-h"){
+                printUsage();
+                std::exit(EXIT_SUCCESS);
+            }
+            else {
+                std::cerr << "Unknown option \"" << arg << "\".\n";
+                printUsage();
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        catch (const std::logic_error&){
+            std::cerr << "Invalid value for \"" << arg << "\".\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    for (auto [width, height] : options.sizes){
+        if (width<=0 || height<=0){
+            std::cerr << "Grid sizes must be positive.\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if (std::find(options.parseIds.begin(), options.parseIds.end(), 0) != options.parseIds.end()){
+        std::cerr << "Generated tilesets need at least one tile id.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (!options.profile.empty() && !profiling){
+        std::cerr << "Profiling is not built in, configure with -DWFC_PROFILE=ON.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (options.seeds==0 || options.repeats==0){
+        std::cerr << "Seeds and repeats must be positive.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    return options;
+}
+
+// peak resident memory of the process so far, never lower than an earlier call (0 where unsupported)
+std::size_t peakMemoryKB(){
+    #if defined(__unix__) || defined(__APPLE__)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        #ifdef __APPLE__
+            return static_cast<std::size_t>(usage.ru_maxrss)/1024;
+        #else
+            return static_cast<std::size_t>(usage.ru_maxrss);
+        #endif
+    #else
+        return 0;
+    #endif
+}
+
+double seconds(Clock::duration duration){
+    return std::chrono::duration<double>(duration).count();
+}
+
+// value at fraction q of sorted samples
+double percentile(const std::vector<double>& sorted, double q){
+    return sorted[static_cast<std::size_t>(q*static_cast<double>(sorted.size()-1))];
+}
+
+const char* name(Propagation propagation){ return propagation==Propagation::support ? "support" : "bitset"; }
+const char* name(Heuristic heuristic){ return heuristic==Heuristic::entropy ? "entropy" : "count"; }
+
+// the regex based reader parseTiles replaced, kept to compare against (exits on malformed files)
+std::shared_ptr<const TileRules> analyzeTilesRegex(const std::string& path){
+
+    std::ifstream dataFile(path);
+    if (!dataFile.is_open()){
+        std::cerr << "Could not open \"" << path << "\". Exiting.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    auto rules = std::make_shared<TileRules>();
+
+    // regex matching "{a,b}", returning a,b as submatches
+    std::regex tileIndices("\\{(\\d+)\\,(\\d+)\\}");
+
+    // index of a tile read from the file
+    auto indexOf = [&](const std::smatch& match){
+        auto it = rules->getIndex.find({std::stoull(match.str(1)), std::stoull(match.str(2))});
+        if (it == rules->getIndex.end()){
+            std::cerr << "Unknown tile " << match.str() << " in \"" << path << "\".\n";
+            std::exit(EXIT_FAILURE);
+        }
+        return it->second;
+    };
+
+    std::string line;
+
+    // check for tileset rotatability
+    std::getline(dataFile,line);
+    if (line.back() == '\r'){ line.pop_back(); }
+
+    if (line=="no rotation"){ rules->rotatable = false; }
+    else if (line=="rotate"){ rules->rotatable = true;  }
+    else {
+        std::cerr << "Rotation type could not be found in \"" << path << "\".\n";
+        std::exit(EXIT_FAILURE);
+    }
+    std::getline(dataFile,line);
+
+    // create list of tiles in braket {a,b} and index form
+    std::size_t id{ 0 }, index{0};
+    std::getline(dataFile,line);
+    if (line.back() == '\r'){ line.pop_back(); }
+
+    // use regex to get each {a,b} a=tile symmetry, b=tile weight
+    auto begin = std::sregex_iterator(line.begin(), line.end(), tileIndices);
+    auto end   = std::sregex_iterator();
+
+    for (std::sregex_iterator i=begin; i!=end; ++i){
+
+        // get symmetry {Sym,_}
+        std::size_t symmetry = std::stoull(i->str(1));
+
+        // save index of unique tiles ignoring rotations
+        rules->nonRotatingIndex[id] = index;
+
+        for (std::size_t j=0; j<symmetry; j++){
+
+            // create maps from tileState<->index
+            rules->getIndex[{id,j}] = index+j;
+            rules->getTile.push_back({id,j});
+
+            // create maps for right and left rotations
+            rules->rightRotation.push_back(index + (j+1)%symmetry);
+            rules->leftRotation.push_back(index + (j+symmetry-1)%symmetry);
+
+            // fill weights for each unique tile
+            rules->weights.push_back(std::stoi(i->str(2)));
+        }
+
+        id++;
+        index += symmetry;
+        rules->symmetryIndex.push_back(symmetry);
+    }
+    std::getline(dataFile, line);
+
+    // set n unique Tiles
+    rules->uniqueTiles = index;
+
+    // keep track of connection names for next part
+    std::unordered_map<std::string, TileSet> connectionTiles;
+
+    // create sets of tiles for named connections
+    while (std::getline(dataFile,line)){
+        if (!line.empty() && line.back() == '\r'){ line.pop_back(); }
+
+        // stop at empty line
+        if (line.empty()){ break; }
+
+        // get name of connection
+        std::size_t pos = line.find('-');
+        std::string name  = line.substr(0,pos-1);
+
+        // use regex to get each unique tile
+        // get matches from beginning to end of line
+        begin = std::sregex_iterator(line.begin(), line.end(), tileIndices);
+        end   = std::sregex_iterator();
+
+        TileSet tiles(rules->uniqueTiles);
+        for (std::sregex_iterator i=begin; i!=end; ++i){ tiles.set(indexOf(*i)); }
+
+        connectionTiles[name] = tiles;
+    }
+
+    rules->connectsTo.assign(rules->uniqueTiles, TileSet(rules->uniqueTiles));
+
+    // finally get leftright connections for each tile
+    while (getline(dataFile,line)){
+        if (!line.empty() && line.back() == '\r'){ line.pop_back(); }
+
+        // stop at empty line
+        if (line.empty()){ break; }
+
+        // read connection name on right
+        std::size_t pos = line.find('-');
+        std::string name  = line.substr(pos+2);
+
+        // use regex to iterate through lines with multiple unique tiles on left
+        begin = std::sregex_iterator(line.begin(), line.end(), tileIndices);
+        end   = std::sregex_iterator();
+
+        for (std::sregex_iterator i=begin; i!=end; ++i){
+            if (!connectionTiles.contains(name)){
+                std::cerr << "Name problem\n";
+                std::exit(EXIT_FAILURE);
+            }
+
+            rules->connectsTo[indexOf(*i)] = connectionTiles[name];
+        }
+    }
+
+    rules->buildCompat();
+
+    return rules;
+}
+
+// data file of a made up rotating tileset with ids tile ids: one connection per four ids, and a
+// rule per unique tile, so a few thousand rules for a thousand ids. Fixed for a number of ids
+std::string generateTileset(std::size_t ids){
+
+    Random random(ids);
+    std::ostringstream text;
+    constexpr std::size_t symmetries[3]{1, 2, 4};
+
+    std::vector<std::size_t> symmetry(ids);
+    text << "rotate\n\n";
+    for (std::size_t id=0; id<ids; id++){
+        symmetry[id] = symmetries[random.below(3)];
+        text << (id > 0 ? "," : "") << "{" << symmetry[id] << "," << 1 + random.below(100) << "}";
+    }
+    text << "\n\n";
+
+    std::size_t connections = std::max<std::size_t>(ids/4, 1);
+    for (std::size_t c=0; c<connections; c++){
+        text << "Edge " << c << " left";
+        std::size_t tiles = 1 + random.below(16);
+        for (std::size_t t=0; t<tiles; t++){
+            std::size_t id = random.below(ids);
+            text << (t > 0 ? "," : " - ") << "{" << id << "," << random.below(symmetry[id]) << "}";
+        }
+        text << "\n";
+    }
+    text << "\n";
+
+    for (std::size_t id=0; id<ids; id++){
+        for (std::size_t j=0; j<symmetry[id]; j++){ text << "{" << id << "," << j << "} - Edge " << random.below(connections) << " left\n"; }
+    }
+
+    return text.str();
+}
+
+// the regex and from_chars parsers on one generated tileset
+struct ParseResult{
+    std::size_t ids{0};
+    std::size_t tiles{0};              // also the number of rules
+    std::size_t bytes{0};
+    double regexSeconds{0.0};          // mean of one parse, both include buildCompat
+    double parseSeconds{0.0};
+    double compatSeconds{0.0};         // mean of buildCompat alone
+    bool same{false};                  // both gave the same rules
+};
+
+// time both parsers on a generated tileset written to a temporary file
+ParseResult runParse(const BenchOptions& options, std::size_t ids){
+
+    ParseResult result;
+    result.ids = ids;
+
+    std::string text = generateTileset(ids);
+    result.bytes = text.size();
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / ("wfc_bench_" + std::to_string(ids) + ".txt");
+    std::ofstream(path, std::ios::binary) << text;
+
+    std::shared_ptr<const TileRules> regex, parsed;
+    auto start = Clock::now();
+    for (std::size_t i=0; i<options.repeats; i++){ regex = analyzeTilesRegex(path.string()); }
+    result.regexSeconds = seconds(Clock::now() - start)/static_cast<double>(options.repeats);
+
+    start = Clock::now();
+    for (std::size_t i=0; i<options.repeats; i++){ parsed = analyzeTiles(path.string()); }
+    result.parseSeconds = seconds(Clock::now() - start)/static_cast<double>(options.repeats);
+
+    TileRules rules = *parsed;
+    start = Clock::now();
+    for (std::size_t i=0; i<options.repeats; i++){ rules.buildCompat(); }
+    result.compatSeconds = seconds(Clock::now() - start)/static_cast<double>(options.repeats);
+
+    result.tiles = parsed->uniqueTiles;
+    result.same = *regex == *parsed;
+
+    std::filesystem::remove(path);
+    return result;
+}
+
+void writeParse(std::ostream& out, const ParseResult& parse){
+    out << "    {\"ids\": " << parse.ids << ", \"tiles\": " << parse.tiles << ", \"bytes\": " << parse.bytes
+        << ", \"regex_us\": " << parse.regexSeconds*1e6 << ", \"from_chars_us\": " << parse.parseSeconds*1e6
+        << ", \"build_compat_us\": " << parse.compatSeconds*1e6 << ", \"same_rules\": " << (parse.same ? "true" : "false") << "}";
+}
+
+// results of one grid size and propagation engine
+struct RunResult{
+    Propagation propagation{Propagation::bitset};
+    int width{0};
+    int height{0};
+    double resetSeconds{0.0};          // mean of one reset
+    std::vector<double> stepSeconds;    // every step of one extra solve, sorted
+    std::size_t solved{0};
+    std::size_t contradictions{0};     // also the ones backtracking recovered from
+    std::size_t restarts{0};
+    std::size_t backtracks{0};
+    std::size_t collapses{0};          // also in attempts which were restarted
+    double solveSeconds{0.0};          // total of all solves
+    std::size_t bytes{0};
+    std::size_t capacity{0};           // tiles per cell of the solver's sets (0: sized at runtime)
+};
+
+// time reset, single steps and full solves of one grid size
+RunResult runSize(const BenchOptions& options, const std::shared_ptr<const TileRules>& rules, Propagation propagation, int width, int height){
+
+    RunResult result;
+    result.propagation = propagation;
+    result.width = width;
+    result.height = height;
+
+    std::unique_ptr<Solver> solver = makeSolver(rules, width, height, propagation, options.heuristic);
+    result.capacity = solver->capacity();
+
+    // reset
+    auto start = Clock::now();
+    for (std::size_t i=0; i<options.repeats; i++){ solver->reset(); }
+    result.resetSeconds = seconds(Clock::now() - start)/static_cast<double>(options.repeats);
+
+    // full solves, restarting on contradiction like wfc_batch
+    std::uint64_t contradictions = solver->totalContradictions;
+    start = Clock::now();
+    for (unsigned long long seed=0; seed<options.seeds; seed++){
+        solver->seed(seed);
+
+        bool solved{false};
+        for (std::size_t attempt=0; attempt<options.maxAttempts && !solved; attempt++){
+            while (!solver->collapsed && solver->getNextCollapse()){ result.collapses++; }
+
+            solved = solver->collapsed;
+            result.backtracks += solver->backtracks;
+            if (!solved){
+                result.restarts++;
+                solver->reset();
+            }
+        }
+        result.solved += solved;
+    }
+    result.solveSeconds = seconds(Clock::now() - start);
+    result.contradictions = static_cast<std::size_t>(solver->totalContradictions - contradictions);
+    result.bytes = solver->memory();
+
+    // single getNextCollapse (collapse and propagate) of one more solve, timed one by one
+    solver->seed(options.seeds);
+    while (!solver->collapsed){
+        auto stepStart = Clock::now();
+        bool ok = solver->getNextCollapse();
+        result.stepSeconds.push_back(seconds(Clock::now() - stepStart));
+        if (!ok){ solver->reset(); }
+    }
+    std::sort(result.stepSeconds.begin(), result.stepSeconds.end());
+
+    return result;
+}
+
+void writeRun(std::ostream& out, const RunResult& run){
+
+    double attempts = static_cast<double>(run.solved + run.restarts);
+    double mean{0.0};
+    for (double step : run.stepSeconds){ mean += step; }
+    mean /= static_cast<double>(run.stepSeconds.size());
+
+    out << "        {\"propagation\": \"" << name(run.propagation) << "\", \"width\": " << run.width << ", \"height\": " << run.height << ",\n"
+        << "         \"reset_us\": " << run.resetSeconds*1e6 << ",\n"
+        << "         \"step_ns\": {\"mean\": " << mean*1e9 << ", \"p50\": " << percentile(run.stepSeconds, 0.5)*1e9
+        << ", \"p99\": " << percentile(run.stepSeconds, 0.99)*1e9 << ", \"max\": " << run.stepSeconds.back()*1e9 << "},\n"
+        << "         \"solved\": " << run.solved << ", \"contradictions\": " << run.contradictions
+        << ", \"contradiction_rate\": " << (attempts > 0 ? static_cast<double>(run.contradictions)/attempts : 0.0)
+        << ", \"restarts\": " << run.restarts << ", \"backtracks\": " << run.backtracks << ",\n"
+        << "         \"seconds\": " << run.solveSeconds
+        << ", \"collapses_per_sec\": " << (run.solveSeconds > 0 ? static_cast<double>(run.collapses)/run.solveSeconds : 0.0)
+        << ", \"solver_bytes\": " << run.bytes << ", \"domain_capacity\": " << run.capacity << "}";
+}
+
+int main(int argc, char* argv[]){
+
+    BenchOptions options = parseOptions(argc, argv);
+
+    // output paths are relative to where we were called from, tilesets to the project root
+    std::filesystem::path outPath = options.out.empty() ? options.out : std::filesystem::absolute(options.out);
+    std::filesystem::path profilePath = options.profile.empty() ? options.profile : std::filesystem::absolute(options.profile);
+    std::filesystem::current_path(rootPath);
+
+    // every shipped tileset, in a fixed order
+    if (options.tilesets.empty()){
+        for (const auto& entry : std::filesystem::directory_iterator(tilesetBaseDir)){
+            if (entry.is_directory()){ options.tilesets.push_back(entry.path().filename().string()); }
+        }
+        std::sort(options.tilesets.begin(), options.tilesets.end());
+    }
+
+    std::ofstream file;
+    if (!outPath.empty()){
+        file.open(outPath);
+        if (!file.is_open()){
+            std::cerr << "Could not open \"" << outPath.string() << "\" for writing.\n";
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& out = outPath.empty() ? std::cout : file;
+
+    out << "{\n"
+        << "  \"seeds\": " << options.seeds << ", \"repeats\": " << options.repeats
+        << ", \"heuristic\": \"" << name(options.heuristic) << "\", \"max_backtracks\": " << maxBacktracks
+        << ", \"union_kernel\": \"" << unionKernelName() << "\",\n";
+
+    bool failed{false};
+
+    // parsers on the generated tilesets
+    out << "  \"parsers\": [\n";
+    for (std::size_t i=0; i<options.parseIds.size(); i++){
+        std::cerr << "parsing " << options.parseIds[i] << " tile ids\n";
+        ParseResult parse = runParse(options, options.parseIds[i]);
+        failed = failed || !parse.same;
+
+        writeParse(out, parse);
+        out << (i+1 < options.parseIds.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n"
+        << "  \"tilesets\": [\n";
+
+    for (std::size_t t=0; t<options.tilesets.size(); t++){
+
+        tilesetDir = options.tilesets[t];
+        std::cerr << "benchmarking " << tilesetDir << "\n";
+
+        // both parsers on their own
+        double regexSeconds{0.0};
+        for (std::size_t i=0; i<options.repeats; i++){
+            auto start = Clock::now();
+            analyzeTilesRegex(pathToData());
+            regexSeconds += seconds(Clock::now() - start);
+        }
+
+        double analyzeSeconds{0.0};
+        std::shared_ptr<const TileRules> rules;
+        for (std::size_t i=0; i<options.repeats; i++){
+            auto start = Clock::now();
+            rules = analyzeTiles();
+            analyzeSeconds += seconds(Clock::now() - start);
+        }
+
+        // loading the compiled rules instead (-1 if there is no up to date rules.bin)
+        double loadSeconds{0.0};
+        bool compiled{true};
+        TilesetError error;
+        for (std::size_t i=0; i<options.repeats && compiled; i++){
+            auto start = Clock::now();
+            compiled = loadCompiledTiles(pathToRules(), pathToData(), error) != nullptr;
+            loadSeconds += seconds(Clock::now() - start);
+        }
+
+        out << "    {\"name\": \"" << tilesetDir << "\", \"tiles\": " << rules->uniqueTiles
+            << ", \"analyze_us\": " << analyzeSeconds/static_cast<double>(options.repeats)*1e6
+            << ", \"analyze_regex_us\": " << regexSeconds/static_cast<double>(options.repeats)*1e6
+            << ", \"load_compiled_us\": " << (compiled ? loadSeconds/static_cast<double>(options.repeats)*1e6 : -1.0) << ",\n"
+            << "     \"runs\": [\n";
+
+        bool first{true};
+        for (Propagation propagation : options.propagations){
+            for (auto [width, height] : options.sizes){
+                RunResult run = runSize(options, rules, propagation, width, height);
+                failed = failed || run.solved < options.seeds;
+
+                out << (first ? "" : ",\n");
+                writeRun(out, run);
+                first = false;
+            }
+        }
+
+        out << "\n     ]}" << (t+1 < options.tilesets.size() ? "," : "") << "\n";
+    }
+
+    out << "  ],\n"
+        << "  \"process_peak_memory_kb\": " << peakMemoryKB() << "\n"
+        << "}\n";
+
+    if (!profilePath.empty() && !writeProfile(profilePath.string(), std::cerr)){
+        std::cerr << "Could not write \"" << profilePath.string() << "\".\n";
+        return EXIT_FAILURE;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -15,6 +15,9 @@
 #include"storage.h"
 #include"utils.h"
 
+// mouse position on window
+Vector2 mousePos{};
+
 struct ButtonBase {
 
    Texture2D& texture;
@@ -144,7 +147,7 @@ bool ButtonIcon::display(){
 
 struct ButtonTile : ButtonBase{
 
-   Bitset controlledTiles;
+   TileSet controlledTiles{tileRules->uniqueTiles};
 
    bool on{true};
 
@@ -155,9 +158,9 @@ struct ButtonTile : ButtonBase{
       bounds = {x, y, tileSize*scale*0.5f, tileSize*scale*0.5f};
       border = {x-1.0f, y-1.0f, bounds.width+2.0f, bounds.height+2.0f};
 
-      // create bitset of controlled tiles
-      for (std::size_t i=0; i<symmetryIndex[rotatingId]; i++){
-         controlledTiles.set(nonRotatingIndex[rotatingId]+i);
+      // create set of controlled tiles
+      for (std::size_t i=0; i<tileRules->symmetryIndex[rotatingId]; i++){
+         controlledTiles.set(tileRules->nonRotatingIndex.at(rotatingId)+i);
       }
    };
 
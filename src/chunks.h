@@ -0,0 +1,278 @@
+#pragma once
+
+#include<cstddef>
+#include<cstdint>
+#include<functional>
+#include<list>
+#include<map>
+#include<memory>
+#include<optional>
+#include<unordered_map>
+#include<utility>
+#include<vector>
+
+#include"analyzeTiles.h"
+#include"domain.h"
+#include"edges.h"
+#include"globals.h"
+#include"point.h"
+#include"profile.h"
+#include"random.h"
+#include"solver.h"
+
+// fixed size piece of an endless world, at chunk coordinate coord (in chunks, not tiles)
+struct Chunk{
+   Point coord;
+
+   // collapsed tiles, row by row
+   std::vector<tileState> tiles;
+};
+
+// Endless world made of chunks, generated on demand with one solver for its tileset.
+// The edge of every neighbouring chunk already in memory constrains the matching edge of a new chunk
+// (see EdgeMatcher), so tiles connect across chunks. Where the neighbours leave no tile for an edge cell,
+// a window across the seam is solved again (EdgeMatcher::repair), which also changes the neighbours' tiles
+// near it; a chunk which still doesn't connect is not kept.
+// Each chunk is seeded from (world seed, chunk coordinate), and only the `capacity` most recently used
+// chunks are kept, so memory stays bounded however far the world is explored.
+// A chunk evicted and later generated again matches the neighbours in memory at that time, which may
+// differ from those it had at first; keep the evicted chunks (onEvict) if they must be found again.
+struct ChunkWorld{
+
+   // size of a chunk in tiles
+   int chunkWidth;
+   int chunkHeight;
+
+   // seed of the whole world
+   std::uint64_t worldSeed;
+
+   // most chunks kept in memory
+   std::size_t capacity;
+
+   // called with every chunk dropped from memory
+   std::function<void(const Chunk&)> onEvict;
+
+   // solver shared by every chunk
+   std::unique_ptr<Solver> solver;
+
+   // chunks from most to least recently used, and where each coordinate is in the list
+   std::list<Chunk> chunks;
+   std::unordered_map<Point, std::list<Chunk>::iterator> index;
+
+   // edges of the chunk being generated
+   EdgeMatcher matcher;
+
+   // chunks generated and evicted so far, and windows re-solved across the seams of new chunks
+   std::size_t generated{0};
+   std::size_t evicted{0};
+   std::size_t repairs{0};
+
+   // side of the window first re-solved around a seam of a new chunk which doesn't connect, doubled up to
+   // maxRepairWindow while the tiles around it leave no solution, and restarts allowed per window
+   int repairWindow{8};
+   int maxRepairWindow{64};
+   std::size_t repairAttempts{10};
+
+   // world of a tileset
+   ChunkWorld(std::shared_ptr<const TileRules> rules, int chunkWidth, int chunkHeight, std::uint64_t worldSeed, std::size_t capacity,
+              Propagation propagation=Propagation::bitset, Heuristic heuristic=Heuristic::count);
+
+   // chunk at coord, generated if it is not in memory (nullptr if it could not be solved in matcher.maxAttempts
+   // restarts, or connected to its neighbours)
+   const Chunk* chunk(const Point& coord);
+
+   // tile at world position (in tiles), generating its chunk if needed (nullopt if it could not be solved)
+   std::optional<tileState> tileAt(long long x, long long y);
+
+   // chunk in memory at coord, nullptr if there is none (does not count as a use)
+   const Chunk* find(const Point& coord) const;
+
+   // seed of the chunk at coord
+   std::uint64_t chunkSeed(const Point& coord) const;
+
+   // number of chunks in memory
+   std::size_t size() const { return chunks.size(); }
+
+   // tiles along the edges of chunk which don't connect to the neighbours in memory
+   std::size_t illegalSeams(const Chunk& chunk) const;
+
+private:
+
+   // repair windows and their solvers, by side
+   EdgeMatcher repairer;
+   std::map<int, std::unique_ptr<Solver>> repairSolvers;
+
+   // round down, also for negative positions
+   static long long floorDiv(long long a, long long b){ return a/b - (a%b < 0); }
+
+   // call f(pos, d, tile) for every cell pos along the edges of the chunk at coord, with the tile of the
+   // neighbour in memory next to it in direction d
+   template <typename F>
+   void forEachSeam(const Point& coord, F f) const;
+
+   // solve the chunk at coord into the solver, returns the number of edge tiles left out
+   // (nullopt if it could not be solved even without its edges)
+   std::optional<std::size_t> solve(const Point& coord);
+
+   // collapsed tiles of the solver
+   Chunk store(const Point& coord) const;
+
+   // re-solve windows across the seams of the chunk at the front of the list which don't connect,
+   // true once they all do
+   bool repair();
+};
+
+ChunkWorld::ChunkWorld(std::shared_ptr<const TileRules> rules, int chunkWidth, int chunkHeight, std::uint64_t worldSeed, std::size_t capacity,
+                       Propagation propagation, Heuristic heuristic):
+   chunkWidth(chunkWidth), chunkHeight(chunkHeight), worldSeed(worldSeed), capacity(capacity > 0 ? capacity : 1),
+   solver(makeSolver(std::move(rules), chunkWidth, chunkHeight, propagation, heuristic)){};
+
+std::uint64_t ChunkWorld::chunkSeed(const Point& coord) const {
+   return mixSeed(worldSeed, coord.x, coord.y);
+}
+
+const Chunk* ChunkWorld::find(const Point& coord) const {
+   auto it = index.find(coord);
+   return it == index.end() ? nullptr : &*it->second;
+}
+
+const Chunk* ChunkWorld::chunk(const Point& coord){
+
+   // move to the front of the list, as most recently used
+   if (auto it = index.find(coord); it != index.end()){
+      chunks.splice(chunks.begin(), chunks, it->second);
+      return &chunks.front();
+   }
+
+   std::optional<std::size_t> unmatched = solve(coord);
+   if (!unmatched){ return nullptr; }
+
+   chunks.push_front(store(coord));
+   index[coord] = chunks.begin();
+
+   // edge cells the matcher left out
+   if (*unmatched > 0 && !repair()){
+      index.erase(coord);
+      chunks.pop_front();
+      return nullptr;
+   }
+
+   generated++;
+
+   // drop least recently used chunks
+   while (chunks.size() > capacity){
+      if (onEvict){ onEvict(chunks.back()); }
+      index.erase(chunks.back().coord);
+      chunks.pop_back();
+      evicted++;
+   }
+
+   return &chunks.front();
+}
+
+std::optional<tileState> ChunkWorld::tileAt(long long x, long long y){
+
+   long long cx = floorDiv(x, chunkWidth), cy = floorDiv(y, chunkHeight);
+   const Chunk* found = chunk({static_cast<int>(cx), static_cast<int>(cy)});
+   if (!found){ return std::nullopt; }
+
+   return found->tiles[static_cast<std::size_t>((y - cy*chunkHeight)*chunkWidth + (x - cx*chunkWidth))];
+}
+
+template <typename F>
+void ChunkWorld::forEachSeam(const Point& coord, F f) const {
+
+   for (std::size_t d=0; d<4; d++){
+
+      const Chunk* neighbour = find(coord + cardinals[d]);
+      if (!neighbour){ continue; }
+
+      // cells along the edge facing the neighbour, and the neighbour's cell next to each
+      bool vertical = cardinals[d].x != 0;
+      int length = vertical ? chunkHeight : chunkWidth;
+
+      for (int i=0; i<length; i++){
+         Point pos = vertical ? Point(cardinals[d].x > 0 ? chunkWidth-1 : 0, i) : Point(i, cardinals[d].y > 0 ? chunkHeight-1 : 0);
+         Point across{(pos.x + cardinals[d].x + chunkWidth)%chunkWidth, (pos.y + cardinals[d].y + chunkHeight)%chunkHeight};
+         f(pos, d, neighbour->tiles[static_cast<std::size_t>(across.y*chunkWidth + across.x)]);
+      }
+   }
+}
+
+std::size_t ChunkWorld::illegalSeams(const Chunk& chunk) const {
+
+   std::size_t count{0};
+   forEachSeam(chunk.coord, [&](const Point& pos, std::size_t d, const tileState& tile){
+      count += !solver->rules->connects(chunk.tiles[static_cast<std::size_t>(pos.y*chunkWidth + pos.x)], d, tile);
+   });
+   return count;
+}
+
+std::optional<std::size_t> ChunkWorld::solve(const Point& coord){
+
+   matcher.clear();
+   forEachSeam(coord, [&](const Point& pos, std::size_t d, const tileState& tile){ matcher.add(*solver->rules, pos, d, tile); });
+
+   // same seed for every try
+   solver->random.seed(chunkSeed(coord));
+
+   return matcher.solve(*solver);
+}
+
+Chunk ChunkWorld::store(const Point& coord) const {
+
+   Chunk stored{coord, {}};
+   stored.tiles.reserve(solver->size());
+
+   for (int y=0; y<chunkHeight; y++){
+      for (int x=0; x<chunkWidth; x++){ stored.tiles.push_back(solver->tileAt(x,y)); }
+   }
+
+   return stored;
+}
+
+bool ChunkWorld::repair(){
+
+   WFC_ZONE("ChunkWorld::repair");
+
+   Chunk& chunk = chunks.front();
+   long long left = static_cast<long long>(chunk.coord.x)*chunkWidth, top = static_cast<long long>(chunk.coord.y)*chunkHeight;
+   repairer.maxAttempts = repairAttempts;
+
+   // tiles of every chunk in memory can be re-solved
+   auto tileAt = [&](long long x, long long y) -> tileState* {
+      long long cx = floorDiv(x, chunkWidth), cy = floorDiv(y, chunkHeight);
+      auto it = index.find({static_cast<int>(cx), static_cast<int>(cy)});
+      if (it == index.end()){ return nullptr; }
+      return &it->second->tiles[static_cast<std::size_t>((y - cy*chunkHeight)*chunkWidth + (x - cx*chunkWidth))];
+   };
+
+   // window centered on cell pos of the chunk, grown while it can't be solved
+   auto around = [&](const Point& pos) -> bool {
+
+      for (int size=repairWindow; size<=maxRepairWindow; size*=2){
+
+         std::unique_ptr<Solver>& window = repairSolvers[size];
+         if (!window){ window = makeSolver(solver->rules, size, size, solver->propagation, solver->heuristic, solver->backtrackLimit); }
+
+         window->random.seed(mixSeed(mixSeed(chunkSeed(chunk.coord), pos.x, pos.y), size, size));
+         if (repairer.repair(*window, left + pos.x - size/2, top + pos.y - size/2, tileAt)){
+            repairs++;
+            return true;
+         }
+      }
+      return false;
+   };
+
+   // a window can have a seam still to repair on its border which leaves it no solution, so go over them
+   // again while that helps
+   bool progress{true};
+   while (progress && illegalSeams(chunk) > 0){
+      progress = false;
+      forEachSeam(chunk.coord, [&](const Point& pos, std::size_t d, const tileState& tile){
+         if (!solver->rules->connects(chunk.tiles[static_cast<std::size_t>(pos.y*chunkWidth + pos.x)], d, tile) && around(pos)){ progress = true; }
+      });
+   }
+
+   return illegalSeams(chunk) == 0;
+}
@@ -0,0 +1,70 @@
+#include<algorithm>
+#include<cstddef>
+#include<cstdlib>
+#include<filesystem>
+#include<iostream>
+#include<memory>
+#include<string>
+#include<string_view>
+#include<vector>
+
+#include"analyzeTiles.h"
+#include"compiledTiles.h"
+#include"globals.h"
+#include"utils.h"
+
+void printUsage(){
+    std::cout << "Usage: wfc_compile_tileset [NAME...]\n"
+              << "  writes tilesets/NAME/rules.bin from tilesets/NAME/data.txt, for every tileset when no name is given\n";
+}
+
+int main(int argc, char* argv[]){
+
+    std::vector<std::string> tilesets;
+    for (int i=1; i<argc; i++){
+        std::string_view arg{argv[i]};
+        if (arg=="--help" || arg=="-h"){
+            printUsage();
+            return EXIT_SUCCESS;
+        }
+        tilesets.emplace_back(arg);
+    }
+
+    std::filesystem::current_path(rootPath);
+
+    if (tilesets.empty()){
+        for (const auto& entry : std::filesystem::directory_iterator(tilesetBaseDir)){
+            if (entry.is_directory()){ tilesets.push_back(entry.path().filename().string()); }
+        }
+        std::sort(tilesets.begin(), tilesets.end());
+    }
+
+    bool failed{false};
+
+    for (const std::string& name : tilesets){
+
+        tilesetDir = name;
+        std::shared_ptr<const TileRules> rules = analyzeTiles();
+
+        // check the file gives back the analyzed rules before anything loads it
+        if (!writeCompiledTiles(pathToRules(), *rules, pathToData())){
+            std::cerr << "Could not write \"" << pathToRules() << "\".\n";
+            failed = true;
+            continue;
+        }
+
+        TilesetError error;
+        std::shared_ptr<const TileRules> compiled = loadCompiledTiles(pathToRules(), pathToData(), error);
+        if (!compiled || *compiled != *rules){
+            if (!error.message.empty()){ std::cerr << error.describe() << "\n"; }
+            std::cerr << "\"" << pathToRules() << "\" does not match \"" << pathToData() << "\".\n";
+            std::filesystem::remove(pathToRules());
+            failed = true;
+            continue;
+        }
+
+        std::cout << pathToRules() << ": " << rules->uniqueTiles << " tiles, " << std::filesystem::file_size(pathToRules()) << " bytes\n";
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<iterator>
+#include<map>
+#include<memory>
+#include<string>
+#include<system_error>
+#include<tuple>
+#include<utility>
+#include<vector>
+
+#include"analyzeTiles.h"
+#include"domain.h"
+#include"globals.h"
+#include"mappedFile.h"
+#include"profile.h"
+#include"utils.h"
+
+// Compiled tileset: the tables of TileRules in one flat binary file (wfc_compile_tileset writes it
+// next to data.txt, which stays the source). Loading maps the file, checks every index in it and copies
+// its arrays into TileRules (whose sets own their words), without any parsing. The file is stale once the
+// size or modification time of data.txt changes. Layout, native byte order, every array 8 byte aligned:
+//    RulesHeader
+//    getTile          uniqueTiles x {uint32 id, uint32 orientation}
+//    rightRotation    uniqueTiles x uint32
+//    leftRotation     uniqueTiles x uint32
+//    weights          uniqueTiles x int32
+//    symmetryIndex    ids x uint32          (orientations of each tile id)
+//    nonRotatingIndex ids x uint32          (first index of each tile id, its place in the atlas)
+//    connectsTo       uniqueTiles x words x uint64
+//    compat           4 x uniqueTiles x words x uint64
+struct RulesHeader{
+   char magic[8];
+   std::uint32_t version;
+   std::uint32_t byteOrder;             // rulesByteOrder as written, anything else was written on another platform
+   std::uint64_t sourceSize;            // of data.txt, a changed source makes the file stale
+   std::int64_t sourceTime;             // modification time of data.txt, in ticks of its file clock
+   std::uint64_t fileSize;
+   std::uint32_t uniqueTiles;
+   std::uint32_t ids;
+   std::uint32_t words;                 // 64 bit words per set of tiles
+   std::uint32_t rotatable;
+};
+
+constexpr char rulesMagic[8]{'W','F','C','R','U','L','E','S'};
+constexpr std::uint32_t rulesVersion{2};
+constexpr std::uint32_t rulesByteOrder{0x01020304};
+
+// size and modification time of a data file, stamped into the files compiled from it (zero if it can't be read).
+// A stat instead of reading the file, an edit keeping both within the clock's resolution goes unnoticed
+std::pair<std::uint64_t, std::int64_t> sourceStamp(const std::string& path){
+
+   std::error_code error;
+   std::uintmax_t size = std::filesystem::file_size(path, error);
+   if (error){ return {0, 0}; }
+
+   std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+   if (error){ return {0, 0}; }
+
+   return {static_cast<std::uint64_t>(size), static_cast<std::int64_t>(time.time_since_epoch().count())};
+}
+
+// offsets of the arrays of a compiled file
+struct RulesLayout{
+   std::size_t getTile, rightRotation, leftRotation, weights, symmetry, nonRotating, connectsTo, compat, size;
+
+   RulesLayout(std::size_t uniqueTiles, std::size_t ids, std::size_t words){
+
+      auto align = [](std::size_t offset){ return (offset + 7)/8*8; };
+      std::size_t sets = uniqueTiles*words*sizeof(std::uint64_t);
+
+      getTile       = align(sizeof(RulesHeader));
+      rightRotation = align(getTile + uniqueTiles*2*sizeof(std::uint32_t));
+      leftRotation  = align(rightRotation + uniqueTiles*sizeof(std::uint32_t));
+      weights       = align(leftRotation + uniqueTiles*sizeof(std::uint32_t));
+      symmetry      = align(weights + uniqueTiles*sizeof(std::int32_t));
+      nonRotating   = align(symmetry + ids*sizeof(std::uint32_t));
+      connectsTo    = align(nonRotating + ids*sizeof(std::uint32_t));
+      compat        = connectsTo + sets;
+      size          = compat + 4*sets;
+   }
+};
+
+// write rules analyzed from the data file at source, false if the file can't be written
+bool writeCompiledTiles(const std::string& path, const TileRules& rules, const std::string& source){
+
+   std::size_t n = rules.uniqueTiles, ids = rules.symmetryIndex.size(), words = TileSet(n).words.size();
+   RulesLayout layout(n, ids, words);
+
+   RulesHeader header{};
+   std::memcpy(header.magic, rulesMagic, sizeof(rulesMagic));
+   header.version = rulesVersion;
+   header.byteOrder = rulesByteOrder;
+   std::tie(header.sourceSize, header.sourceTime) = sourceStamp(source);
+   header.fileSize = layout.size;
+   header.uniqueTiles = static_cast<std::uint32_t>(n);
+   header.ids = static_cast<std::uint32_t>(ids);
+   header.words = static_cast<std::uint32_t>(words);
+   header.rotatable = rules.rotatable;
+
+   std::vector<char> bytes(layout.size, 0);
+   std::memcpy(bytes.data(), &header, sizeof(header));
+
+   auto put = [&](std::size_t offset, auto value){ std::memcpy(bytes.data() + offset, &value, sizeof(value)); };
+
+   for (std::size_t t=0; t<n; t++){
+      put(layout.getTile + t*8, static_cast<std::uint32_t>(rules.getTile[t].x));
+      put(layout.getTile + t*8 + 4, static_cast<std::uint32_t>(rules.getTile[t].y));
+      put(layout.rightRotation + t*4, static_cast<std::uint32_t>(rules.rightRotation[t]));
+      put(layout.leftRotation + t*4, static_cast<std::uint32_t>(rules.leftRotation[t]));
+      put(layout.weights + t*4, static_cast<std::int32_t>(rules.weights[t]));
+      std::memcpy(bytes.data() + layout.connectsTo + t*words*8, rules.connectsTo[t].words.data(), words*8);
+      for (std::size_t d=0; d<4; d++){
+         std::memcpy(bytes.data() + layout.compat + (d*n + t)*words*8, rules.compat[d][t].words.data(), words*8);
+      }
+   }
+
+   for (std::size_t id=0; id<ids; id++){
+      put(layout.symmetry + id*4, static_cast<std::uint32_t>(rules.symmetryIndex[id]));
+      put(layout.nonRotating + id*4, static_cast<std::uint32_t>(rules.nonRotatingIndex.at(id)));
+   }
+
+   std::ofstream file(path, std::ios::binary);
+   file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+   return static_cast<bool>(file);
+}
+
+// rules from a compiled file, nullptr if it is missing, from another version or platform, or was
+// compiled from another version of the data file at source. Also nullptr, with error set, if its
+// contents are inconsistent (e.g. a tile index out of range), so nothing indexes out of bounds later
+std::shared_ptr<const TileRules> loadCompiledTiles(const std::string& path, const std::string& source, TilesetError& error){
+
+   WFC_ZONE("loadCompiledTiles");
+
+   error = TilesetError{path, 0, 0, {}};
+
+   MappedFile file(path);
+   if (file.size < sizeof(RulesHeader)){ return nullptr; }
+
+   RulesHeader header;
+   std::memcpy(&header, file.data, sizeof(header));
+
+   auto [sourceSize, sourceTime] = sourceStamp(source);
+   if (std::memcmp(header.magic, rulesMagic, sizeof(rulesMagic)) != 0 || header.version != rulesVersion || header.byteOrder != rulesByteOrder
+       || header.fileSize != file.size || header.sourceSize != sourceSize || header.sourceTime != sourceTime){ return nullptr; }
+
+   auto fail = [&](const std::string& message) -> std::shared_ptr<const TileRules> {
+      error.message = message;
+      return nullptr;
+   };
+
+   std::size_t n = header.uniqueTiles, ids = header.ids, words = header.words;
+   if (words != (n + 63)/64){ return fail("sets of " + std::to_string(words) + " words can't hold " + std::to_string(n) + " tiles"); }
+
+   RulesLayout layout(n, ids, words);
+   if (layout.size != file.size){ return fail("size does not match " + std::to_string(n) + " tiles of " + std::to_string(ids) + " ids"); }
+
+   // arrays are aligned in the file and the mapping starts on a page
+   auto array = [&](std::size_t offset){ return reinterpret_cast<const std::uint32_t*>(file.data + offset); };
+   const std::uint32_t* getTile = array(layout.getTile);
+   const std::uint32_t* rightRotation = array(layout.rightRotation);
+   const std::uint32_t* leftRotation = array(layout.leftRotation);
+   const std::int32_t* weights = reinterpret_cast<const std::int32_t*>(file.data + layout.weights);
+   const std::uint32_t* symmetry = array(layout.symmetry);
+   const std::uint32_t* nonRotating = array(layout.nonRotating);
+
+   // every index in range, before any of them is used: each id's orientations follow the ones of the id
+   // before it, and tile t is orientation t - nonRotating[id] of its id
+   std::size_t first{0};
+   for (std::size_t id=0; id<ids; id++){
+      if (symmetry[id]!=1 && symmetry[id]!=2 && symmetry[id]!=4){ return fail("symmetry of tile id " + std::to_string(id) + " must be 1, 2 or 4"); }
+      if (nonRotating[id] != first){ return fail("tile id " + std::to_string(id) + " does not start at tile " + std::to_string(first)); }
+      first += symmetry[id];
+   }
+   if (first != n){ return fail("tile ids have " + std::to_string(first) + " orientations, not " + std::to_string(n)); }
+
+   for (std::size_t t=0; t<n; t++){
+      std::uint32_t id = getTile[2*t], orientation = getTile[2*t+1];
+      if (id >= ids || orientation >= symmetry[id] || nonRotating[id] + orientation != t){ return fail("tile " + std::to_string(t) + " is not a known orientation"); }
+      if (rightRotation[t] >= n || leftRotation[t] >= n){ return fail("tile " + std::to_string(t) + " rotates to an unknown tile"); }
+      if (weights[t] < 0){ return fail("tile " + std::to_string(t) + " has a negative weight"); }
+   }
+
+   // no tile past the last one in any set
+   const std::uint64_t* sets = reinterpret_cast<const std::uint64_t*>(file.data + layout.connectsTo);
+   std::uint64_t unused = n%64 ? ~((std::uint64_t{1} << (n%64)) - 1) : 0;
+   for (std::size_t set=0; set<5*n && words>0; set++){
+      if (sets[set*words + words-1] & unused){ return fail("set " + std::to_string(set) + " holds a tile past the last one"); }
+   }
+
+   auto rules = std::make_shared<TileRules>();
+   rules->rotatable = header.rotatable != 0;
+   rules->uniqueTiles = n;
+
+   rules->getTile.resize(n);
+   rules->weights.assign(weights, weights + n);
+   rules->rightRotation.assign(rightRotation, rightRotation + n);
+   rules->leftRotation.assign(leftRotation, leftRotation + n);
+   rules->symmetryIndex.assign(symmetry, symmetry + ids);
+
+   // sorted keys, inserted at the end without searching
+   for (std::size_t id=0; id<ids; id++){ rules->nonRotatingIndex.emplace_hint(rules->nonRotatingIndex.end(), id, nonRotating[id]); }
+   for (std::size_t t=0; t<n; t++){
+      rules->getTile[t] = {getTile[2*t], getTile[2*t+1]};
+      rules->getIndex.emplace_hint(rules->getIndex.end(), rules->getTile[t], t);
+   }
+
+   auto table = [&](std::size_t offset, std::vector<TileSet>& table){
+      const std::uint64_t* row = reinterpret_cast<const std::uint64_t*>(file.data + offset);
+      table.resize(n);
+      for (std::size_t t=0; t<n; t++, row+=words){ table[t].words.assign(row, row + words); }
+   };
+   table(layout.connectsTo, rules->connectsTo);
+   for (std::size_t d=0; d<4; d++){ table(layout.compat + d*n*words*8, rules->compat[d]); }
+
+   // not stored, derived from compat
+   rules->buildMutualCompat();
+
+   return rules;
+}
+
+// rules of the tileset in tilesetDir: the compiled file if it is up to date, else analyzed from data.txt.
+// Kept for the life of the process, so changing back to a tileset or starting more workers is free
+// (not thread safe, load on the main thread and share the rules)
+std::shared_ptr<const TileRules> loadRules(){
+
+   static std::map<std::string, std::shared_ptr<const TileRules>> cache;
+
+   std::shared_ptr<const TileRules>& rules = cache[tilesetDir];
+   if (!rules){
+      TilesetError error;
+      rules = loadCompiledTiles(pathToRules(), pathToData(), error);
+      if (!error.message.empty()){ std::cerr << error.describe() << ", reading \"" << pathToData() << "\" instead\n"; }
+   }
+   if (!rules){ rules = analyzeTiles(pathToData()); }
+
+   return rules;
+}
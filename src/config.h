@@ -0,0 +1,181 @@
+#pragma once
+
+#include<algorithm>
+#include<cstdint>
+#include<cstdlib>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<stdexcept>
+#include<string>
+#include<string_view>
+#include<tuple>
+#include<utility>
+
+#include"globals.h"
+#include"profile.h"
+
+// Settings of the viewer, read from the command line and an optional config file.
+// The file has one "key value" pair per line, using the option names without "--" (e.g. "size 64x32"),
+// "#" starts a comment. Options given on the command line override the file.
+struct Config{
+   int gridWidth{::gridWidth};
+   int gridHeight{::gridHeight};
+   int nCalcs{::nCalcs};
+   float solveBudget{::solveBudget};
+   float scaling{::scaling};   // 0 fits the grid in the window
+   int screenWidth{::screenWidth};
+   int screenHeight{::screenHeight};
+   std::string tileset{};      // random when empty
+   bool seeded{false};
+   std::uint64_t seed{0};
+   std::string profile{};      // Chrome trace written on exit, none when empty (absolute, the viewer changes directory)
+
+   // read command line (and the config file it names), exits on bad input
+   void parse(int argc, char* argv[]);
+
+   // read a config file, exits on bad input
+   void load(const std::string& path);
+
+   // set one option from its name and value, false if the name is unknown
+   bool set(std::string_view key, const std::string& value);
+
+   // copy settings into the globals used by the grid and window
+   void apply() const;
+};
+
+void printConfigUsage(){
+   std::cout << "Usage: WFC [options]\n"
+             << "  --config FILE      read options from FILE (\"key value\" per line, e.g. \"size 64x32\")\n"
+             << "  --size WxH         grid size in cells (default " << ::gridWidth << "x" << ::gridHeight << ")\n"
+             << "  --budget MS        milliseconds of a frame spent solving on builds without threads (default " << ::solveBudget << ")\n"
+             << "  --steps N          builds without threads only: most collapses solved per frame, 0 for no limit (default " << ::nCalcs << ").\n"
+             << "                     Threaded builds solve on their own thread, the menu's Speed slider sets how fast tiles are shown\n"
+             << "  --scale S          tile size multiplier, 0 fits the grid in the window (default " << ::scaling << ")\n"
+             << "  --window WxH       window size in pixels (default " << ::screenWidth << "x" << ::screenHeight << ")\n"
+             << "  --tileset NAME     tileset directory in tilesets/ (default random)\n"
+             << "  --seed N           seed of the first map (default random)\n"
+             << "  --profile FILE     on exit, write a Chrome trace to FILE and print its zones and counters (WFC_PROFILE builds)\n";
+}
+
+// "WxH" into (W,H), throws on bad input
+std::pair<int,int> parseSize(const std::string& size){
+   std::size_t pos = size.find('x');
+   if (pos==std::string::npos){ throw std::invalid_argument("size"); }
+   return {std::stoi(size.substr(0,pos)), std::stoi(size.substr(pos+1))};
+}
+
+bool Config::set(std::string_view key, const std::string& value){
+
+   if (key=="size"){ std::tie(gridWidth, gridHeight) = parseSize(value); }
+   else if (key=="steps"){ nCalcs = std::stoi(value); }
+   else if (key=="budget"){ solveBudget = std::stof(value); }
+   else if (key=="scale"){ scaling = std::stof(value); }
+   else if (key=="window"){ std::tie(screenWidth, screenHeight) = parseSize(value); }
+   else if (key=="tileset"){ tileset = value; }
+   else if (key=="seed"){
+      seed = std::stoull(value);
+      seeded = true;
+   }
+   else if (key=="profile"){ profile = std::filesystem::absolute(value).string(); }
+   else { return false; }
+
+   return true;
+}
+
+void Config::load(const std::string& path){
+
+   std::ifstream file(path);
+   if (!file.is_open()){
+      std::cerr << "Could not open config file \"" << path << "\".\n";
+      std::exit(EXIT_FAILURE);
+   }
+
+   std::string line;
+   for (int number=1; std::getline(file, line); number++){
+
+      // strip comments and surrounding whitespace
+      line = line.substr(0, line.find('#'));
+      std::size_t first = line.find_first_not_of(" \t\r");
+      if (first==std::string::npos){ continue; }
+      std::size_t last = line.find_last_not_of(" \t\r");
+      line = line.substr(first, last-first+1);
+
+      std::size_t split = line.find_first_of(" \t=");
+      std::string key = line.substr(0, split);
+      std::string value = split==std::string::npos ? "" : line.substr(line.find_first_not_of(" \t=", split));
+
+      try {
+         if (!set(key, value)){
+            std::cerr << path << ":" << number << ": unknown option \"" << key << "\".\n";
+            std::exit(EXIT_FAILURE);
+         }
+      }
+      catch (const std::logic_error&){
+         std::cerr << path << ":" << number << ": invalid value for \"" << key << "\".\n";
+         std::exit(EXIT_FAILURE);
+      }
+   }
+}
+
+void Config::parse(int argc, char* argv[]){
+
+   // the config file comes first, so the command line can override it
+   for (int i=1; i+1<argc; i++){
+      if (std::string_view{argv[i]}=="--config"){ load(argv[i+1]); }
+   }
+
+   for (int i=1; i<argc; i++){
+      std::string_view arg{argv[i]};
+
+      if (arg=="--help" || arg=="-h"){
+         printConfigUsage();
+         std::exit(EXIT_SUCCESS);
+      }
+
+      if (!arg.starts_with("--") || i+1 >= argc){
+         std::cerr << "Invalid option \"" << arg << "\".\n";
+         printConfigUsage();
+         std::exit(EXIT_FAILURE);
+      }
+
+      std::string value{argv[++i]};
+      if (arg=="--config"){ continue; }
+
+      try {
+         if (!set(arg.substr(2), value)){
+            std::cerr << "Unknown option \"" << arg << "\".\n";
+            printConfigUsage();
+            std::exit(EXIT_FAILURE);
+         }
+      }
+      catch (const std::logic_error&){
+         std::cerr << "Invalid value for \"" << arg << "\".\n";
+         std::exit(EXIT_FAILURE);
+      }
+   }
+
+   if (gridWidth<=0 || gridHeight<=0 || screenWidth<=0 || screenHeight<=0 || nCalcs<0 || solveBudget<=0.0f || scaling<0.0f){
+      std::cerr << "Sizes, steps, budget and scale must be positive.\n";
+      std::exit(EXIT_FAILURE);
+   }
+
+   if (!profile.empty() && !profiling){
+      std::cerr << "Profiling is not built in, configure with -DWFC_PROFILE=ON.\n";
+      std::exit(EXIT_FAILURE);
+   }
+}
+
+void Config::apply() const {
+
+   ::gridWidth    = gridWidth;
+   ::gridHeight   = gridHeight;
+   ::nCalcs       = nCalcs;
+   ::solveBudget  = solveBudget;
+   ::screenWidth  = screenWidth;
+   ::screenHeight = screenHeight;
+
+   // fit the whole grid in the window
+   ::scaling = scaling > 0.0f ? scaling : std::min(static_cast<float>(screenWidth)/(gridWidth*tileSize), static_cast<float>(screenHeight)/(gridHeight*tileSize));
+   ::tileScaled = ::scaling*tileSize;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include<array>
+#include<bit>
+#include<cstddef>
+#include<cstdint>
+#include<type_traits>
+#include<vector>
+
+// Set of tiles (e.g. the possible tiles of a cell), one bit per tile index packed into 64 bit words.
+// Words > 0 fixes the width at compile time, so operations on small tilesets are a few word instructions
+// (the solver picks the smallest width that fits the tileset). Words == 0 sizes it at runtime for any
+// number of tiles; sets of the same tileset then always have the same number of words.
+template<std::size_t Words>
+struct Domain{
+
+   using Storage = std::conditional_t<Words==0, std::vector<std::uint64_t>, std::array<std::uint64_t,Words>>;
+
+   Storage words{};
+
+   Domain() = default;
+
+   // empty (or full) set for a tileset of n tiles
+   explicit Domain(std::size_t n, bool full=false);
+
+   // largest number of tiles (0 when sized at runtime)
+   static constexpr std::size_t capacity(){ return Words*64; }
+
+   bool operator[](std::size_t i) const { return (words[i/64] >> (i%64)) & 1u; }
+   bool test(std::size_t i) const { return (*this)[i]; }
+
+   Domain& set(std::size_t i){ words[i/64] |= std::uint64_t{1} << (i%64); return *this; }
+   Domain& reset(std::size_t i){ words[i/64] &= ~(std::uint64_t{1} << (i%64)); return *this; }
+
+   std::size_t count() const;
+   bool any() const;
+   bool none() const { return !any(); }
+
+   // lowest tile in the set (undefined when empty)
+   std::size_t first() const;
+
+   // call f(i) for every tile i in the set, in increasing order
+   template<typename F>
+   void forEach(F f) const;
+
+   // first tile i in increasing order for which f(i) is true (capacity of the words if none)
+   template<typename F>
+   std::size_t find(F f) const;
+
+   Domain& operator&=(const Domain& other);
+   Domain& operator|=(const Domain& other);
+   Domain& operator^=(const Domain& other);
+
+   // remove the tiles of other (a &= ~b without a temporary)
+   Domain& andNot(const Domain& other);
+
+   Domain operator&(const Domain& other) const { return Domain(*this) &= other; }
+   Domain operator|(const Domain& other) const { return Domain(*this) |= other; }
+   Domain operator^(const Domain& other) const { return Domain(*this) ^= other; }
+
+   // complement. Also sets the unused bits of the last word, so only use it as a mask (a & ~b)
+   Domain operator~() const;
+
+   bool operator==(const Domain& other) const = default;
+};
+
+// runtime sized set, used for tileset data of any size
+using TileSet = Domain<0>;
+
+template<std::size_t Words>
+Domain<Words>::Domain(std::size_t n, bool full){
+
+   if constexpr (Words==0){ words.assign((n+63)/64, 0); }
+
+   if (!full){ return; }
+
+   for (std::size_t i=0; i<n/64; i++){ words[i] = ~std::uint64_t{0}; }
+   if (n%64){ words[n/64] = (std::uint64_t{1} << (n%64)) - 1; }
+}
+
+template<std::size_t Words>
+std::size_t Domain<Words>::count() const {
+   std::size_t total{0};
+   for (std::uint64_t word : words){ total += static_cast<std::size_t>(std::popcount(word)); }
+   return total;
+}
+
+template<std::size_t Words>
+bool Domain<Words>::any() const {
+   for (std::uint64_t word : words){
+      if (word){ return true; }
+   }
+   return false;
+}
+
+template<std::size_t Words>
+std::size_t Domain<Words>::first() const {
+   for (std::size_t i=0; i<words.size(); i++){
+      if (words[i]){ return i*64 + static_cast<std::size_t>(std::countr_zero(words[i])); }
+   }
+   return words.size()*64;
+}
+
+template<std::size_t Words>
+template<typename F>
+void Domain<Words>::forEach(F f) const {
+   for (std::size_t i=0; i<words.size(); i++){
+
+      // clear the lowest bit until the word is empty
+      for (std::uint64_t word = words[i]; word; word &= word-1){
+         f(i*64 + static_cast<std::size_t>(std::countr_zero(word)));
+      }
+   }
+}
+
+template<std::size_t Words>
+template<typename F>
+std::size_t Domain<Words>::find(F f) const {
+   for (std::size_t i=0; i<words.size(); i++){
+      for (std::uint64_t word = words[i]; word; word &= word-1){
+         std::size_t tile = i*64 + static_cast<std::size_t>(std::countr_zero(word));
+         if (f(tile)){ return tile; }
+      }
+   }
+   return words.size()*64;
+}
+
+template<std::size_t Words>
+Domain<Words>& Domain<Words>::operator&=(const Domain& other){
+   for (std::size_t i=0; i<words.size(); i++){ words[i] &= other.words[i]; }
+   return *this;
+}
+
+template<std::size_t Words>
+Domain<Words>& Domain<Words>::operator|=(const Domain& other){
+   for (std::size_t i=0; i<words.size(); i++){ words[i] |= other.words[i]; }
+   return *this;
+}
+
+template<std::size_t Words>
+Domain<Words>& Domain<Words>::operator^=(const Domain& other){
+   for (std::size_t i=0; i<words.size(); i++){ words[i] ^= other.words[i]; }
+   return *this;
+}
+
+template<std::size_t Words>
+Domain<Words>& Domain<Words>::andNot(const Domain& other){
+   for (std::size_t i=0; i<words.size(); i++){ words[i] &= ~other.words[i]; }
+   return *this;
+}
+
+template<std::size_t Words>
+Domain<Words> Domain<Words>::operator~() const {
+   Domain result(*this);
+   for (std::uint64_t& word : result.words){ word = ~word; }
+   return result;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include<algorithm>
+#include<cstddef>
+#include<optional>
+#include<vector>
+
+#include"analyzeTiles.h"
+#include"domain.h"
+#include"globals.h"
+#include"point.h"
+#include"solver.h"
+
+// cell of a solver's grid which must connect to a tile already placed next to the grid
+struct EdgeConstraint{
+   Point pos;
+
+   // tiles allowed in the cell
+   const TileSet* tiles;
+};
+
+// Solves grids whose edges must connect to neighbouring grids solved before (chunks of a world,
+// pieces of a large map). Neighbours solved apart from each other can leave no solution (e.g. at a
+// corner between two of them), the edge cells which contradict the others are then left out, and
+// repair() re-solves a window across the seam afterwards so it connects on every side.
+// Keeps its buffers between grids, one per solver.
+struct EdgeMatcher{
+
+   // constraints of the grid being solved, and the ones left out
+   std::vector<EdgeConstraint> edge;
+   std::vector<bool> skipped;
+
+   // restarts allowed per grid
+   std::size_t maxAttempts{100};
+
+   // restarts of the last solve, and decisions undone over all of its attempts
+   std::size_t restarts{0};
+   std::size_t backtracks{0};
+
+   // forget the constraints of the previous grid
+   void clear(){ edge.clear(); }
+
+   // cell pos must connect to tile, placed next to it in direction d
+   void add(const TileRules& rules, const Point& pos, std::size_t d, const tileState& tile);
+
+   // solve from the solver's current random state, returns the number of edge cells left out
+   // (nullopt if the grid could not be solved even without its edges)
+   std::optional<std::size_t> solve(Solver& solver);
+
+   // Re-solve the window of a larger grid at (left, top), of the solver's size, so it connects to every tile
+   // around it. tileAt(x,y) points to the tile at a position of the larger grid, nullptr where there is none
+   // (outside of it, or not generated yet): such cells are solved but not written. False, leaving the grid
+   // as it was, if the tiles around the window leave no solution or it could not be solved in maxAttempts.
+   template <typename TileAt>
+   bool repair(Solver& solver, long long left, long long top, TileAt tileAt);
+
+private:
+
+   // reset the solver and restrict its edge cells, leaving out the ones which contradict the others
+   void match(Solver& solver);
+};
+
+void EdgeMatcher::add(const TileRules& rules, const Point& pos, std::size_t d, const tileState& tile){
+
+   // the tile is in direction d, so we are in the opposite direction from it, and must allow it back
+   edge.push_back({pos, &rules.mutualCompat[(d+2)%4][rules.getIndex.at(tile)]});
+}
+
+std::optional<std::size_t> EdgeMatcher::solve(Solver& solver){
+
+   skipped.assign(edge.size(), false);
+   restarts = 0;
+   backtracks = 0;
+
+   // restarts continue the random sequence, and reset the solver's backtracks
+   for (std::size_t attempt=0; attempt<maxAttempts; attempt++, restarts++){
+      match(solver);
+      bool solved = solver.solve();
+      backtracks += solver.backtracks;
+      if (solved){ return static_cast<std::size_t>(std::count(skipped.begin(), skipped.end(), true)); }
+   }
+
+   // the matched edge cells may still leave no solution, try on its own
+   skipped.assign(edge.size(), true);
+   for (std::size_t attempt=0; attempt<maxAttempts; attempt++, restarts++){
+      solver.reset();
+      bool solved = solver.solve();
+      backtracks += solver.backtracks;
+      if (solved){ return edge.size(); }
+   }
+
+   return std::nullopt;
+}
+
+template <typename TileAt>
+bool EdgeMatcher::repair(Solver& solver, long long left, long long top, TileAt tileAt){
+
+   // every cell written back must connect to the tiles just outside the window
+   clear();
+   for (int y=0; y<solver.height; y++){
+      for (int x=0; x<solver.width; x++){
+
+         if (!tileAt(left+x, top+y)){ continue; }
+
+         for (std::size_t d=0; d<4; d++){
+            Point next = Point(x,y) + cardinals[d];
+            if (next.x>=0 && next.x<solver.width && next.y>=0 && next.y<solver.height){ continue; }
+            if (const tileState* tile = tileAt(left+next.x, top+next.y)){ add(*solver.rules, {x,y}, d, *tile); }
+         }
+      }
+   }
+
+   skipped.assign(edge.size(), false);
+   restarts = 0;
+   backtracks = 0;
+
+   for (std::size_t attempt=0; attempt<maxAttempts; attempt++, restarts++){
+
+      // an edge cell left out means the tiles around contradict each other, whatever the seed
+      match(solver);
+      if (std::find(skipped.begin(), skipped.end(), true) != skipped.end()){ return false; }
+
+      bool solved = solver.solve();
+      backtracks += solver.backtracks;
+      if (!solved){ continue; }
+
+      for (int y=0; y<solver.height; y++){
+         for (int x=0; x<solver.width; x++){
+            if (tileState* tile = tileAt(left+x, top+y)){ *tile = solver.tileAt(x,y); }
+         }
+      }
+      return true;
+   }
+
+   return false;
+}
+
+void EdgeMatcher::match(Solver& solver){
+
+   bool matched{false};
+   while (!matched){
+
+      solver.reset();
+      matched = true;
+
+      // on a contradiction, start over without the cell which caused it
+      for (std::size_t i=0; i<edge.size() && matched; i++){
+         if (skipped[i] || solver.constrain(edge[i].pos, *edge[i].tiles)){ continue; }
+         skipped[i] = true;
+         matched = false;
+      }
+   }
+}
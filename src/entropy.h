@@ -0,0 +1,223 @@
+#pragma once
+
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+#include"random.h"
+
+// Uncollapsed cells grouped by their number of possibilities. Each group is a dense array and cells are
+// removed by swapping with the last element, so moving a cell and randomly picking one of the lowest
+// entropy cells are O(1)
+struct EntropyList{
+
+   // buckets[n] holds the cells with n possibilities
+   std::vector<std::vector<std::size_t>> buckets;
+
+   // bucket of each cell and its index in that bucket
+   std::vector<std::uint16_t> bucketOf;
+   std::vector<std::uint32_t> indexOf;
+
+   // no bucket below lowest holds any cells
+   std::size_t lowest{0};
+
+   // number of cells in all buckets
+   std::size_t cells{0};
+
+   // remove all cells. Cell ids must be below nCells and counts at most maxCount
+   void reset(std::size_t nCells, std::size_t maxCount);
+
+   // add cell with count possibilities
+   void insert(std::size_t cell, std::size_t count);
+
+   // remove cell (e.g. once collapsed)
+   void erase(std::size_t cell);
+
+   // move cell after its number of possibilities changed
+   void update(std::size_t cell, std::size_t count);
+
+   bool empty() const { return cells==0; }
+   std::size_t size() const { return cells; }
+
+   // lowest number of possibilities of any cell
+   std::size_t minimum();
+
+   // random cell out of those with the lowest number of possibilities
+   std::size_t sample(Random& random);
+};
+
+void EntropyList::reset(std::size_t nCells, std::size_t maxCount){
+
+   // keep the capacity of every bucket, so resets don't allocate
+   if (buckets.size() < maxCount+1){ buckets.resize(maxCount+1); }
+   for (auto& bucket : buckets){ bucket.clear(); }
+
+   bucketOf.resize(nCells);
+   indexOf.resize(nCells);
+
+   lowest = 0;
+   cells  = 0;
+}
+
+void EntropyList::insert(std::size_t cell, std::size_t count){
+
+   std::vector<std::size_t>& bucket = buckets[count];
+
+   bucketOf[cell] = static_cast<std::uint16_t>(count);
+   indexOf[cell]  = static_cast<std::uint32_t>(bucket.size());
+   bucket.push_back(cell);
+
+   if (count < lowest || cells == 0){ lowest = count; }
+   cells++;
+}
+
+void EntropyList::erase(std::size_t cell){
+
+   std::vector<std::size_t>& bucket = buckets[bucketOf[cell]];
+
+   // move last cell of the bucket into the hole
+   std::size_t last = bucket.back();
+   bucket[indexOf[cell]] = last;
+   indexOf[last] = indexOf[cell];
+   bucket.pop_back();
+
+   cells--;
+}
+
+void EntropyList::update(std::size_t cell, std::size_t count){
+   erase(cell);
+   insert(cell, count);
+}
+
+std::size_t EntropyList::minimum(){
+
+   // buckets only empty from below when cells are collapsed, so search upwards
+   while (buckets[lowest].empty()){ lowest++; }
+
+   return lowest;
+}
+
+std::size_t EntropyList::sample(Random& random){
+
+   const std::vector<std::size_t>& bucket = buckets[minimum()];
+
+   // check if there is only one possible cell
+   if (bucket.size()==1){ return bucket[0]; }
+
+   return bucket[random.below(bucket.size())];
+}
+
+// Uncollapsed cells ordered by a floating point key (e.g. weighted Shannon entropy). Indexed binary min heap,
+// so the lowest cell is found in O(1) and a cell's key can move in either direction in O(log n)
+struct EntropyHeap{
+
+   // cells in heap order
+   std::vector<std::size_t> heap;
+
+   // key and index in heap of each cell
+   std::vector<double> keys;
+   std::vector<std::uint32_t> indexOf;
+
+   // remove all cells. Cell ids must be below nCells
+   void reset(std::size_t nCells);
+
+   // add cell with key
+   void insert(std::size_t cell, double key);
+
+   // remove cell (e.g. once collapsed)
+   void erase(std::size_t cell);
+
+   // change key of cell
+   void update(std::size_t cell, double key);
+
+   bool empty() const { return heap.empty(); }
+   std::size_t size() const { return heap.size(); }
+
+   // cell with the lowest key
+   std::size_t top() const { return heap[0]; }
+
+private:
+
+   void place(std::size_t index, std::size_t cell){
+      heap[index] = cell;
+      indexOf[cell] = static_cast<std::uint32_t>(index);
+   }
+
+   void siftUp(std::size_t index);
+   void siftDown(std::size_t index);
+};
+
+void EntropyHeap::reset(std::size_t nCells){
+
+   // keep capacity, so resets don't allocate
+   heap.clear();
+   keys.resize(nCells);
+   indexOf.resize(nCells);
+}
+
+void EntropyHeap::insert(std::size_t cell, double key){
+
+   keys[cell] = key;
+   heap.push_back(cell);
+   indexOf[cell] = static_cast<std::uint32_t>(heap.size()-1);
+
+   siftUp(heap.size()-1);
+}
+
+void EntropyHeap::erase(std::size_t cell){
+
+   std::size_t index = indexOf[cell];
+   std::size_t last  = heap.back();
+   heap.pop_back();
+
+   // removed the last element, nothing to reorder
+   if (index == heap.size()){ return; }
+
+   // move last cell into the hole, it may need to go either way
+   place(index, last);
+   siftUp(index);
+   siftDown(indexOf[last]);
+}
+
+void EntropyHeap::update(std::size_t cell, double key){
+
+   double old = keys[cell];
+   keys[cell] = key;
+
+   if (key < old){ siftUp(indexOf[cell]); }
+   else { siftDown(indexOf[cell]); }
+}
+
+void EntropyHeap::siftUp(std::size_t index){
+
+   std::size_t cell = heap[index];
+
+   while (index > 0){
+      std::size_t parent = (index-1)/2;
+      if (keys[heap[parent]] <= keys[cell]){ break; }
+
+      place(index, heap[parent]);
+      index = parent;
+   }
+
+   place(index, cell);
+}
+
+void EntropyHeap::siftDown(std::size_t index){
+
+   std::size_t cell = heap[index];
+
+   while (true){
+      std::size_t child = 2*index+1;
+      if (child >= heap.size()){ break; }
+
+      // pick the smaller child
+      if (child+1 < heap.size() && keys[heap[child+1]] < keys[heap[child]]){ child++; }
+      if (keys[cell] <= keys[heap[child]]){ break; }
+
+      place(index, heap[child]);
+      index = child;
+   }
+
+   place(index, cell);
+}
@@ -1,14 +1,14 @@
 #pragma once
 
 #include<array>
-#include<bitset>
 #include<cstddef>
 #include<random>
+#include<string>
 #include<string_view>
 #include<utility>
 
 #include"point.h"
-#include"raylib.h"
+#include"random.h"
 
 //-----------------------------------
 // Constants
@@ -17,28 +17,12 @@
 // simulation fps
 constexpr int fps{60};
 
-// tile size multiplier
-constexpr int scaling{2};
-
-// number of simulated steps per display
-constexpr int nCalcs{2};
+// most tiles shown per second with the speed slider (solving is not tied to it)
+constexpr int maxUpdateSpeed{2*fps};
 
 // tile width/height original size (pixels)
 constexpr int tileSize{32};
 constexpr int tileArea{tileSize*tileSize};
-constexpr int tileScaled{scaling*tileSize};
-
-// grid dimensions
-constexpr int gridWidth{24};
-constexpr int gridHeight{12};
-
-// window size
-constexpr int screenWidth{gridWidth*tileSize*scaling};
-constexpr int screenHeight{gridHeight*tileSize*scaling};
-
-// bitset max and alias
-constexpr std::size_t N=128;
-using Bitset = std::bitset<N>;
 
 // cardinal directions (right, bottom, left, up)
 constexpr std::array<Point,4> cardinals{Point(1,0),Point(0,1),Point(-1,0),Point(0,-1)};
@@ -51,6 +35,10 @@ constexpr const char* rootPath{R"(./)"};
 constexpr const char* tilesetBaseDir{"tilesets/"};
 constexpr const char* tilesetFile{"/tileset.png"};
 constexpr const char* tilesetDataFile{"/data.txt"};
+constexpr const char* tilesetRulesFile{"/rules.bin"};        // compiled by wfc_compile_tileset
+
+// undone collapses allowed per run before a contradiction resets the grid (0 always resets)
+constexpr std::size_t maxBacktracks{1000};
 
 // wait time after a grid collapse
 constexpr float waitTime{5.0f};
@@ -62,19 +50,31 @@ constexpr bool debug{false};
 // Variables
 //-----------------------------------
 
+// grid dimensions (default, set at startup by config.h)
+int gridWidth{24};
+int gridHeight{12};
+
+// without a solver thread: milliseconds of each frame spent solving, and most collapses per frame (0: no limit)
+float solveBudget{4.0f};
+int nCalcs{0};
+
+// tile size multiplier and tile width/height on screen
+float scaling{2.0f};
+float tileScaled{scaling*tileSize};
+
+// window size, independent of the grid size
+int screenWidth{1536};
+int screenHeight{768};
+
 // clearer names for rotate() 
 enum dir{clockwise=true, anticlockwise=false};
 
-// mouse position on window
-Vector2 mousePos{};
-
 // elapsed time since last update
 float sinceLastUpdate{};
 
 // selected tileset directory
 std::string tilesetDir{};
 
-// random numbers
-std::random_device rd;
-std::mt19937 gen(rd());
+// random numbers, different on every run (solvers have their own generator, which can be seeded)
+Random gen{std::random_device{}()};
 
@@ -1,46 +1,88 @@
 #pragma once
 
 #include<algorithm>
-#include<array>
-#include<bitset>
-#include<climits>
+#include<cmath>
 #include<cstddef>
-#include<filesystem>
-#include<iterator>
+#include<cstdint>
+#include<iostream>
+#include<limits>
 #include<map>
-#include<queue>
-#include<random>
-#include<unordered_set>
+#include<memory>
+#include<string>
 #include<utility>
 #include<vector>
 
 #include"raylib.h"
 
 #include"analyzeTiles.h"
+#include"compiledTiles.h"
 #include"globals.h"
+#include"profile.h"
+#include"solver.h"
+#include"solverThread.h"
 #include"storage.h"
 #include"utils.h"
 
+// tiles to draw from, without rotating. For rotatable tilesets each tile id has four slots holding its
+// rotations (baked once per tileset), otherwise the slots are the columns of the tileset texture
+struct TileAtlas{
+   Texture2D* texture{nullptr};
+   int columns{1};
+   bool rotated{false};
+
+   // average color of each column of the tileset texture (rotating doesn't change it)
+   std::vector<Color> averages;
+
+   Rectangle source(const tileState& tile) const;
+   Color average(const tileState& tile) const;
+};
+
+TileAtlas loadAtlas();
+
 struct Grid{
 
+   // headless solver (wave, entropies and list of collapses), sized for the tileset
+   std::unique_ptr<Solver> solver{makeSolver(loadTileset(loadRules()))};
+
+   // runs the solver once update starts it, from then on it is only reached through commands
+   SolverThread solving;
+
+   // map being shown, bumped on every reset, and the weights and pause last sent to the solver
+   std::uint32_t generation{0};
+   std::vector<int> sentWeights{currentWeights};
+   bool sentRunning{true};
+
+   // updates received from the solver, in the order they were collapsed
+   std::vector<std::pair<Point,tileState>> updates;
+
    // tileset
    Texture2D* texture{textureStore.getPtr(pathToTexture())};
 
-   // bitset grid
-   std::vector<std::vector<Bitset>> bitsetGrid;
+   // tileset with the rotations baked in
+   TileAtlas atlas{loadAtlas()};
 
    // texture grid
    std::vector<std::vector<tileState>> tileGrid;
 
-   // map of number of connections for each tile. Only keeps track of uncollapsed tiles
-   std::map<std::size_t,std::unordered_set<Point>> entropyList;
+   // view of the grid, in tile pixels. Zoom with the mouse wheel, pan by dragging with the right
+   // or middle button, home goes back to the start
+   Camera2D camera{{0.0f, 0.0f}, {0.0f, 0.0f}, 0.0f, scaling};
 
-   // array of all updates
-   std::array<std::pair<Point,tileState>, gridWidth*gridHeight> updates;
+   // below this many screen pixels per cell each cell is drawn as one pixel of its tile's average color
+   float lodCellPixels{6.0f};
 
-   // indexes for updates filling & display
-   std::size_t fillingIndex{0};  // next index to fill from getNextCollapse
-   std::size_t currentIndex{0};  // index of currently visible update
+   // the window as last drawn, only the cells set since then are drawn again while the camera stays
+   RenderTexture2D canvas{};
+   std::vector<Point> dirty;
+   bool redrawAll{true};
+
+   // one pixel per cell for zoomed out views, with the rows changed since they were last uploaded
+   std::vector<Color> lodPixels;
+   Texture2D lodTexture{};
+   int lodFirstRow{0}, lodEndRow{0};
+
+   // index of currently visible update
+   std::size_t currentIndex{0};
 
    // grid update time
    int updateSpeed{30};
@@ -54,65 +96,122 @@ struct Grid{
    // internal time
    float internalTime{0.0f};
 
-   // flag for full collapse
-   bool collapsed{false};
-
    // construct grid.
    Grid();
 
    // debugging tileset analysis. Shows left<->right connections for each unique tile
    void debugTileset();
-   std::map<tileState, Bitset>::iterator debugIt;
+   std::map<tileState, std::size_t>::const_iterator debugIt;
 
    // Update grid
    void update();
 
-   // simulate next collape
-   bool getNextCollapse();
-
-   // propagate effects of collapse
-   bool propagate(const Point& currentPos);
-
    // Draw grid
    void draw();
 
    // reset grid to default state
    void reset();
 
+   // set a cell of the texture grid, to be drawn next frame
+   void setTile(std::size_t x, std::size_t y, const tileState& tile);
+
+   // draw every cell again next frame, after the texture grid was replaced
+   void redraw();
+
+   // zoom and pan from the mouse, true if the view moved
+   bool moveCamera();
+
+   // free the canvas and lod textures (before the window closes)
+   void unloadCanvas();
+
    // pause for duration
    bool waiting();
-
-   // reset entropy list (used to find next tile to collapse)
-   void resetEntropy();
 };
 
-// place all tiles at maximum entropy
-void Grid::resetEntropy(){
+// analyze the chose tileset (in solver), create grid
+Rectangle TileAtlas::source(const tileState& tile) const{
+
+   int slot = rotated ? static_cast<int>(tile.x*4 + tile.y) : static_cast<int>(tileRules->nonRotatingIndex.at(tile.x) + tile.y);
+
+   return {static_cast<float>(slot%columns*tileSize), static_cast<float>(slot/columns*tileSize), tileSize, tileSize};
+}
+
+Color TileAtlas::average(const tileState& tile) const{
+
+   std::size_t column = rotated ? tile.x : tileRules->nonRotatingIndex.at(tile.x) + tile.y;
+
+   return column < averages.size() ? averages[column] : RAYWHITE;
+}
+
+TileAtlas loadAtlas(){
+
+   Texture2D* texture = textureStore.getPtr(pathToTexture());
+   Image tiles = LoadImage(pathToTexture().c_str());
+
+   // average color of every tile, over the background it is drawn on
+   std::vector<Color> averages;
+   Color* pixels = LoadImageColors(tiles);
+   for (int column=0; column<tiles.width/tileSize; column++){
+      float sum[3]{};
+      for (int y=0; y<tileSize; y++){
+         for (int x=0; x<tileSize; x++){
+            Color pixel = pixels[y*tiles.width + column*tileSize + x];
+            float alpha = pixel.a/255.0f;
+            sum[0] += pixel.r*alpha + RAYWHITE.r*(1.0f - alpha);
+            sum[1] += pixel.g*alpha + RAYWHITE.g*(1.0f - alpha);
+            sum[2] += pixel.b*alpha + RAYWHITE.b*(1.0f - alpha);
+         }
+      }
+      auto channel = [](float total){ return static_cast<unsigned char>(std::lround(total/tileArea)); };
+      averages.push_back({channel(sum[0]), channel(sum[1]), channel(sum[2]), 255});
+   }
+   UnloadImageColors(pixels);
+
+   if (!tileRules->rotatable){
+      UnloadImage(tiles);
+      return {texture, std::max(texture->width/tileSize, 1), false, std::move(averages)};
+   }
+
+   // four rotations of every tile, in a roughly square atlas to stay under texture size limits
+   int ids = texture->width/tileSize;
+   int slots = ids*4;
+   int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(slots))));
+
+   std::string name = pathToTexture() + "#rotated";
+   if (textureStore.contains(name)){
+      UnloadImage(tiles);
+      return {textureStore.getPtr(name), columns, true, std::move(averages)};
+   }
+
+   Image atlas = GenImageColor(columns*tileSize, (slots + columns - 1)/columns*tileSize, BLANK);
 
-   entropyList.clear();
+   for (int id=0; id<ids; id++){
+      Image tile = ImageFromImage(tiles, {static_cast<float>(id*tileSize), 0.0f, tileSize, tileSize});
 
-   // fill entropyList
-   for (int i=0; i<gridWidth; i++){
-      for (int j=0; j<gridHeight; j++){
-         entropyList[uniqueTiles].insert({i,j});
+      // slot id*4+rotation holds the tile turned rotation*90 degrees clockwise
+      for (int rotation=0; rotation<4; rotation++){
+         int slot = id*4 + rotation;
+         ImageDraw(&atlas, tile, {0.0f, 0.0f, tileSize, tileSize},
+                   {static_cast<float>(slot%columns*tileSize), static_cast<float>(slot/columns*tileSize), tileSize, tileSize}, WHITE);
+         ImageRotateCW(&tile);
       }
+      UnloadImage(tile);
    }
+
+   Texture2D* baked = textureStore.add(name, LoadTextureFromImage(atlas));
+   UnloadImage(tiles);
+   UnloadImage(atlas);
+
+   return {baked, columns, true, std::move(averages)};
 }
 
-// analyze the chose tileset, create grid, fill entropies
 Grid::Grid(){
 
-   // analyze tileset data
-   analyzeTiles();
-
-   bitsetGrid = std::vector<std::vector<Bitset>>(gridHeight,std::vector<Bitset>(gridWidth,Bitset(std::string(uniqueTiles,'1'))));
    tileGrid = std::vector<std::vector<tileState>>(gridHeight, std::vector<tileState>(gridWidth));
-
-   // fill entropyList (set all tiles to max)
-   resetEntropy();
+   redraw();
 
    // setup debug it
-   if constexpr (debug){ debugIt = getBitset.begin(); }
+   if constexpr (debug){ debugIt = tileRules->getIndex.begin(); }
 }
 
 bool Grid::waiting(){
@@ -131,18 +230,8 @@ bool Grid::waiting(){
 
 void Grid::reset(){
    
-   // reset Grids
-   bitsetGrid = std::vector<std::vector<Bitset>>(gridHeight,std::vector<Bitset>(gridWidth,Bitset(std::string(uniqueTiles,'1'))));
-   tileGrid = std::vector<std::vector<tileState>>(gridHeight, std::vector<tileState>(gridWidth));
-
-   // reset Entropy
-   resetEntropy();
-
-   // set state to uncollapsed
-   collapsed = false;
-
-   // swap out weights
-   for (std::size_t i=0; i<weights.size(); i++){
+   // swap out weights (before the wave, which starts from the enabled tiles)
+   for (std::size_t i=0; i<currentWeights.size(); i++){
       if (!weightSwitch[i]    ){ currentWeights[i] = savedWeights[i]; }
       if (!nextWeightSwitch[i]){ savedWeights[i] = currentWeights[i]; }
 
@@ -150,180 +239,103 @@ void Grid::reset(){
    }
    weightSwitch = nextWeightSwitch;
 
+   // reset wave, entropies and updates, on the solver's thread if it runs
+   generation++;
+   if (solving.running()){
+      SolverCommand command;
+      command.kind = SolverCommand::Kind::reset;
+      command.generation = generation;
+      command.weights = currentWeights;
+      command.enabled = weightSwitch;
+      solving.send(std::move(command));
+   }
+   else {
+      solver->weights = currentWeights;
+      solver->enabled = weightSwitch;
+      solver->reset();
+   }
+   sentWeights = currentWeights;
+   updates.clear();
+
+   // reset texture grid
+   tileGrid = std::vector<std::vector<tileState>>(gridHeight, std::vector<tileState>(gridWidth));
+   redraw();
+
    // set wait timer to 0
    waitTimer = 0.0f;
 
    // reset updates indexes
-   fillingIndex = 0;
    currentIndex = 0;
    internalTime = 0.0f;
 }
 
-//------------------------------
-// collapse a tile
-//------------------------------
-bool Grid::getNextCollapse(){
+void Grid::update(){
 
-   // get list of lowest entropies
-   auto it = entropyList.begin();
-   auto& [entropy, tiles] = *it;
-   
-   // grid position to collapse
-   Point currentPos;
+   WFC_ZONE("Grid::update");
 
-   // check if theres is only one possible tile to collapse
-   if (tiles.size()==1){ currentPos = *tiles.begin(); }
-   // otherwise, choose a tile randomly
-   else { std::sample(tiles.begin(), tiles.end(), &currentPos, 1, gen); }
+   //-----------------------
+   // Calculate collapses
+   //-----------------------
 
-   // aliases for convenience
-   Bitset& currentBitset = bitsetGrid[static_cast<std::size_t>(currentPos.y)][static_cast<std::size_t>(currentPos.x)];
+   if (!debug){
 
-   // if there are multiple possibilities
-   if (entropy!=1){
-      
-      // get all possible unique tiles to collapse to and set up weights
-      std::vector<std::size_t> possibilities;
-      std::vector<int> adjustedWeights;
-      for (std::size_t i=0; i<uniqueTiles; i++){
-         if (currentBitset[i]){
-            possibilities.push_back(i);
-            adjustedWeights.push_back(currentWeights[i]);
-         }
+      // the solver runs from the first update on
+      if (!solving.running()){
+         solving.start(*solver, generation);
+         sentRunning = true;
       }
 
-      // set up a distribution
-      std::discrete_distribution dist(adjustedWeights.begin(), adjustedWeights.end());
-
-      // get bitset of new tile and orientation
-      currentBitset = Bitset{}.set(possibilities[dist(gen)]);
-   }
-
-   // add update to update list
-   updates[fillingIndex++] = {currentPos, getTile[currentBitset]};
-
-   // remove from entropyList (only keep uncollapsed tiles)
-   tiles.erase(currentPos);
-   if (tiles.empty()){ entropyList.erase(it); }
-
-   // check if wavefunction is fully collapsed
-   if (entropyList.empty()){
-      collapsed = true;
-      return true;
-   }
-
-   // propagate collapse
-   return propagate(currentPos);   
-}
-
-//------------------------------
-// propagate collapse
-//------------------------------
-bool Grid::propagate(const Point& currentPos){
-   
-   // keep track of tiles that have been resolved and those already in queue
-   std::unordered_set<Point> resolvedTiles, inQueue;
-
-   // queue of tiles to resolve (need queue as FIFO, want to resolve newly added tiles last)
-   std::queue<Point> toResolve{{currentPos}};
-
-   // Breadth-first seach. Resolve nearest neighbours, then next nearest etc. 
-   while (!toResolve.empty()){
-
-      // get the top of the queue
-      Point& resolvingPos = toResolve.front();
-      Bitset& resolvingBitset = bitsetGrid[resolvingPos.y][resolvingPos.x];
-
-      // propagate possibilities for neighbours
-      for (std::size_t i=0; i<4; i++){
-
-         // get position of neighbour
-         Point nearPos = resolvingPos + cardinals[i];
-
-         // check that we aren't out of bounds
-         if (nearPos.x<0 || nearPos.y<0 || nearPos.x>=gridWidth || nearPos.y>=gridHeight){ continue; }
-
-         // get bitset of neighbour
-         Bitset& nearBitset = bitsetGrid[nearPos.y][nearPos.x];
-
-         // if neighbour is collapsed or resolved, ignore and continue
-         if (nearBitset.count()==1 || resolvedTiles.contains(nearPos)){ continue; }
-
-         // for each tile resolvingPos can be, find all possible connections to neighbour
-         Bitset newPossibilities;
-         for (std::size_t j=0; j<uniqueTiles; j++){
-
-            // ignore tiles resolvingPos can't be
-            if (!resolvingBitset[j]){ continue; }
-
-            // left is current possibility, right is bitset of all tiles that connect to left
-            Bitset left{Bitset{}.set(j)}, right;
-
-            // rotate current tile so that we can look up left<->right connections
-            rotate(left, i, dir::anticlockwise);
-
-            // get possible connections
-            right = connectsTo[left];            
-
-            // rotate connections back to original orientation
-            rotate(right, i, dir::clockwise);
-
-            // find all possibilites from union (bitwise |=) of all individual possibilities
-            newPossibilities |= right;
-         }         
+      // weights changed in the menus apply to the next choices, and pausing pauses the solver too
+      if (currentWeights != sentWeights){
+         sentWeights = currentWeights;
+         SolverCommand command;
+         command.kind = SolverCommand::Kind::weights;
+         command.weights = currentWeights;
+         solving.send(std::move(command));
+      }
+      if (running != sentRunning){
+         sentRunning = running;
+         SolverCommand command;
+         command.kind = SolverCommand::Kind::pause;
+         command.paused = !running;
+         solving.send(std::move(command));
+      }
 
-         // remove all disabled tiles (weight = 0)
-         newPossibilities &= weightSwitch;
+      // without threads, solve for the frame's budget
+      if constexpr (!SolverThread::threaded){ solving.step(solveBudget/1000.0, nCalcs); }
 
-         std::size_t oldCount=nearBitset.count(), newCount;
+      // take what the solver made since last frame
+      SolverUpdate update;
+      while (solving.updates.pop(update)){
 
-         // take all previous possible states in nearBitset and remove those not in newPossibilities
-         nearBitset &= newPossibilities;
+         // left from before a reset
+         if (update.generation != generation){ continue; }
 
-         // count possibilities
-         newCount = nearBitset.count();
+         if (update.kind == SolverUpdate::Kind::tile){ updates.emplace_back(update.pos, update.state); }
 
-         // if there is no possible tile to collapse to, resets
-         if (newCount == 0){
-            std::cerr << "Tile {" << resolvingPos.x << "," << resolvingPos.y << "} cannot be collapsed. Resetting grid.\n";
+         // if there is no possible tile to collapse to, reset
+         else if (update.kind == SolverUpdate::Kind::stuck){
+            std::cerr << "Grid cannot be collapsed. Resetting grid.\n";
             reset();
-            return false;
+            return;
          }
 
-         // if number of possibilities has changed, update entropyList
-         if (newCount != oldCount){
-            auto iter = entropyList.find(oldCount);
-            iter->second.erase(nearPos);
-            if (iter->second.empty()){ entropyList.erase(iter); }
-            entropyList[newCount].insert(nearPos);
+         else if (update.kind == SolverUpdate::Kind::rewind){
+            updates.resize(update.index);
+
+            // a backtrack undid collapses which are already visible, rebuild the grid up to where it went back to
+            if (update.index < currentIndex){
+               tileGrid = std::vector<std::vector<tileState>>(gridHeight, std::vector<tileState>(gridWidth));
+               for (std::size_t i=0; i<update.index; i++){
+                  auto& [pos, state] = updates[i];
+                  tileGrid[static_cast<std::size_t>(pos.y)][static_cast<std::size_t>(pos.x)] = state;
+               }
+               redraw();
+
+               currentIndex = update.index;
+               internalTime = static_cast<float>(currentIndex);
+            }
          }
-
-         // add neighbour to resolving queue, if not added already
-         if (!inQueue.contains(nearPos)){
-            toResolve.push(nearPos);
-            inQueue.insert(nearPos);
-         }
-      }
-
-      // add tile to resolved list
-      resolvedTiles.insert(resolvingPos);
-
-      // pop tile from resolving queue
-      toResolve.pop();
-   }
-
-   return true;   
-}
-
-void Grid::update(){
-   //-----------------------
-   // Calculate collapses
-   //-----------------------
-
-   // while grid isn't collapsed, calculate next nCalc steps each frame
-   if (!debug && !collapsed){
-      for (int i=0; i<nCalcs; i++){
-         if (!getNextCollapse()){ return ; }
       }
    }
 
@@ -352,8 +364,8 @@ void Grid::update(){
    // update internal time
    internalTime += static_cast<float>(updateSpeed)/fps;
 
-   // get new index to display
-   std::size_t toDisplay = static_cast<std::size_t>(internalTime);
+   // get new index to display, never past the solver (which can go back on a backtrack)
+   std::size_t toDisplay = std::min(static_cast<std::size_t>(internalTime), updates.size());
 
    // check if index is different
    if (toDisplay != currentIndex){     
@@ -364,86 +376,209 @@ void Grid::update(){
          auto& nextState = updates[currentIndex]; 
 
          // apply update 
-         tileGrid[static_cast<std::size_t>(nextState.first.y)][static_cast<std::size_t>(nextState.first.x)] = nextState.second;
+         setTile(static_cast<std::size_t>(nextState.first.x), static_cast<std::size_t>(nextState.first.y), nextState.second);
 
          // if at last index, wait 5 seconds before resetting
-         if (++currentIndex == gridHeight*gridWidth-1){
+         if (++currentIndex == solver->size()-1){
             waitTimer = waitTime;
          }
       }
    }
 }
 
+void Grid::setTile(std::size_t x, std::size_t y, const tileState& tile){
+
+   tileGrid[y][x] = tile;
+   if (!redrawAll){ dirty.emplace_back(static_cast<int>(x), static_cast<int>(y)); }
+
+   lodPixels[y*static_cast<std::size_t>(gridWidth) + x] = atlas.average(tile);
+   lodFirstRow = std::min(lodFirstRow, static_cast<int>(y));
+   lodEndRow = std::max(lodEndRow, static_cast<int>(y) + 1);
+}
+
+void Grid::redraw(){
+
+   redrawAll = true;
+   dirty.clear();
+
+   lodPixels.resize(static_cast<std::size_t>(gridWidth*gridHeight));
+   for (std::size_t j=0; j<tileGrid.size(); j++){
+      for (std::size_t i=0; i<tileGrid[j].size(); i++){ lodPixels[j*static_cast<std::size_t>(gridWidth) + i] = atlas.average(tileGrid[j][i]); }
+   }
+   lodFirstRow = 0;
+   lodEndRow = gridHeight;
+}
+
+bool Grid::moveCamera(){
+
+   Camera2D before = camera;
+
+   // from fitting half the window up to a tile covering 8 screen pixels per tile pixel
+   float fit = std::min(static_cast<float>(screenWidth)/static_cast<float>(gridWidth*tileSize), static_cast<float>(screenHeight)/static_cast<float>(gridHeight*tileSize));
+   float minZoom = std::min(fit*0.5f, scaling), maxZoom = std::max(8.0f, scaling);
+
+   // zoom around the cursor
+   float wheel = GetMouseWheelMove();
+   if (wheel != 0.0f){
+      Vector2 mouse = GetMousePosition();
+      camera.target = GetScreenToWorld2D(mouse, camera);
+      camera.offset = mouse;
+      camera.zoom = std::clamp(camera.zoom*std::pow(1.15f, wheel), minZoom, maxZoom);
+   }
+
+   if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT) || IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)){
+      Vector2 delta = GetMouseDelta();
+      camera.target.x -= delta.x/camera.zoom;
+      camera.target.y -= delta.y/camera.zoom;
+   }
+
+   if (IsKeyPressed(KEY_HOME)){ camera = {{0.0f, 0.0f}, {0.0f, 0.0f}, 0.0f, scaling}; }
+
+   return camera.offset.x != before.offset.x || camera.offset.y != before.offset.y || camera.target.x != before.target.x
+       || camera.target.y != before.target.y || camera.zoom != before.zoom;
+}
+
+void Grid::unloadCanvas(){
+
+   if (canvas.id != 0){ UnloadRenderTexture(canvas); }
+   if (lodTexture.id != 0){ UnloadTexture(lodTexture); }
+   canvas = RenderTexture2D{};
+   lodTexture = Texture2D{};
+}
+
 void Grid::draw(){
 
-   // draw grid
-   for (int j=0; j<gridHeight; j++){
-      for (int i=0; i<gridWidth; i++){
+   WFC_ZONE("Grid::draw");
+
+   if (moveCamera()){ redrawAll = true; }
 
-         const tileState& tile = tileGrid[j][i];
+   float gridPixelsWidth = static_cast<float>(gridWidth*tileSize), gridPixelsHeight = static_cast<float>(gridHeight*tileSize);
 
-         if (rotatable){
-            DrawTexturePro(*texture,
-                           {static_cast<float>(tile.x*tileSize), 0.0f, tileSize, tileSize},
-                           {static_cast<float>(i*tileScaled+tileScaled/2.0f), static_cast<float>(j*tileScaled+tileScaled/2.0f), tileScaled, tileScaled},
-                           {tileScaled/2.0f, tileScaled/2.0f},
-                           tile.y*90.0f,
-                           WHITE);
+   //-----------------------------------------
+   // Zoomed out: one pixel per cell
+   //-----------------------------------------
+   if (camera.zoom*tileSize < lodCellPixels){
+
+      if (lodTexture.id == 0){
+         Image blank = GenImageColor(gridWidth, gridHeight, RAYWHITE);
+         lodTexture = LoadTextureFromImage(blank);
+         UnloadImage(blank);
+         lodFirstRow = 0;
+         lodEndRow = gridHeight;
+      }
+
+      // upload the rows changed since last time, they are contiguous
+      if (lodFirstRow < lodEndRow){
+         UpdateTextureRec(lodTexture, {0.0f, static_cast<float>(lodFirstRow), static_cast<float>(gridWidth), static_cast<float>(lodEndRow - lodFirstRow)},
+                          lodPixels.data() + static_cast<std::size_t>(lodFirstRow)*static_cast<std::size_t>(gridWidth));
+         lodFirstRow = gridHeight;
+         lodEndRow = 0;
+      }
+
+      BeginMode2D(camera);
+      DrawTexturePro(lodTexture, {0.0f, 0.0f, static_cast<float>(gridWidth), static_cast<float>(gridHeight)},
+                     {0.0f, 0.0f, gridPixelsWidth, gridPixelsHeight}, {0.0f, 0.0f}, 0.0f, WHITE);
+      EndMode2D();
+
+      // the canvas is out of date once zoomed back in
+      redrawAll = true;
+      dirty.clear();
+      return;
+   }
+
+   //-----------------------------------------
+   // Zoomed in: tiles of the visible cells
+   //-----------------------------------------
+
+   // cells inside the window
+   Vector2 topLeft = GetScreenToWorld2D({0.0f, 0.0f}, camera);
+   Vector2 bottomRight = GetScreenToWorld2D({static_cast<float>(screenWidth), static_cast<float>(screenHeight)}, camera);
+   int firstX = std::clamp(static_cast<int>(std::floor(topLeft.x/tileSize)), 0, gridWidth);
+   int firstY = std::clamp(static_cast<int>(std::floor(topLeft.y/tileSize)), 0, gridHeight);
+   int endX = std::clamp(static_cast<int>(std::ceil(bottomRight.x/tileSize)), 0, gridWidth);
+   int endY = std::clamp(static_cast<int>(std::ceil(bottomRight.y/tileSize)), 0, gridHeight);
+
+   if (canvas.id == 0){
+      canvas = LoadRenderTexture(screenWidth, screenHeight);
+      redrawAll = true;
+   }
+
+   auto drawTile = [&](int i, int j){
+      const tileState& tile = tileGrid[static_cast<std::size_t>(j)][static_cast<std::size_t>(i)];
+      DrawTextureRec(*atlas.texture, atlas.source(tile), {static_cast<float>(i*tileSize), static_cast<float>(j*tileSize)}, WHITE);
+   };
+
+   // bring the canvas up to date
+   if (redrawAll || !dirty.empty()){
+      BeginTextureMode(canvas);
+      BeginMode2D(camera);
+
+      if (redrawAll){
+         ClearBackground(RAYWHITE);
+         for (int j=firstY; j<endY; j++){
+            for (int i=firstX; i<endX; i++){ drawTile(i, j); }
          }
-         else {
-            DrawTexturePro(*texture,
-                           {static_cast<float>((nonRotatingIndex[tile.x] + tile.y)*tileSize), 0.0f, tileSize, tileSize},
-                           {static_cast<float>(i*tileScaled+tileScaled/2.0f), static_cast<float>(j*tileScaled+tileScaled/2.0f), tileScaled, tileScaled},
-                           {tileScaled/2.0f, tileScaled/2.0f},
-                           0.0f,
-                           WHITE);
+      }
+      else {
+         for (const Point& cell : dirty){
+            if (cell.x < firstX || cell.x >= endX || cell.y < firstY || cell.y >= endY){ continue; }
+
+            // clear the cell first, in case of transparent tiles
+            DrawRectangle(cell.x*tileSize, cell.y*tileSize, tileSize, tileSize, RAYWHITE);
+            drawTile(cell.x, cell.y);
          }
       }
+
+      EndMode2D();
+      EndTextureMode();
+      redrawAll = false;
+      dirty.clear();
    }
 
-   if constexpr (debug){
-      for (int i=0; i<gridHeight; i++){
-         DrawLine(0.0f, static_cast<float>(i*tileScaled), gridWidth*tileScaled, static_cast<float>(i*tileScaled), RED);
-      }   
+   // render textures are stored upside down
+   float width = static_cast<float>(canvas.texture.width), height = static_cast<float>(canvas.texture.height);
+   DrawTextureRec(canvas.texture, {0.0f, 0.0f, width, -height}, {0.0f, 0.0f}, WHITE);
 
-      for (int i=0; i<gridWidth; i++){
-         DrawLine(static_cast<float>(i*tileScaled), 0.0f, static_cast<float>(i*tileScaled), gridWidth*tileScaled, RED);
-      }
-   }   
+   if constexpr (debug){
+      BeginMode2D(camera);
+      for (int i=0; i<=gridHeight; i++){ DrawLineV({0.0f, static_cast<float>(i*tileSize)}, {gridPixelsWidth, static_cast<float>(i*tileSize)}, RED); }
+      for (int i=0; i<=gridWidth; i++){ DrawLineV({static_cast<float>(i*tileSize), 0.0f}, {static_cast<float>(i*tileSize), gridPixelsHeight}, RED); }
+      EndMode2D();
+   }
 }
 
 void Grid::debugTileset(){
 
    // stop when it==last unique tile
-   if (debugIt==getBitset.end()){ 
+   if (debugIt==tileRules->getIndex.end()){ 
       reset();
       return;
    }
 
-   auto [state,bitset] = *debugIt;
+   auto [state,index] = *debugIt;
 
    // clear grid
    reset();
 
    // set {0,0} to a unique tile
-   tileGrid[3][0] = state;
+   setTile(0, 3, state);
 
    // display all left<->right connections to current state
-   Bitset connections = connectsTo[bitset];
+   const TileSet& connections = tileRules->connectsTo[index];
    std::size_t j{0}, k{2};
-   for (std::size_t i=0; i<uniqueTiles; i++){
+   for (std::size_t i=0; i<tileRules->uniqueTiles; i++){
 
       // ignore impossible connections
       if (!connections[i]){ continue; }
 
       // move to newline if there are many connections
-      if (j==gridHeight){
+      if (j==static_cast<std::size_t>(gridHeight)){
          j=0;
          k++;
       }
 
       // set a grid tiles to show connections
-      tileGrid[j++][k] = getTile[Bitset{}.set(i)];
+      setTile(k, j++, tileRules->getTile[i]);
    }
 
    debugIt++;
@@ -454,31 +589,19 @@ void Grid::debugTileset(){
 //--------------------------------------------
 void changeTileset(const std::string& newTileset, Grid& grid){
 
-   // reset global data
-   nonRotatingIndex.clear();
-   symmetryIndex.clear();
-   getBitset.clear();
-   getTile.clear();
-   connectsTo.clear();
-   rightRotation.clear();
-   leftRotation.clear();
-   weights.clear();
-   currentWeights.clear();
-   savedWeights.clear();
-   weightSwitch.set();
-   nextWeightSwitch.set();
-
    // swap out tileset
    tilesetDir = newTileset;
 
-   // analyze tileset
-   analyzeTiles();
+   // analyze tileset, with a solver sized for it (once the old one has stopped)
+   grid.solving.stop();
+   grid.solver = makeSolver(loadTileset(loadRules()));
 
-   // change grid texture pointer
+   // change grid texture pointer and atlas
    grid.texture = textureStore.getPtr(pathToTexture());
+   grid.atlas = loadAtlas();
 
    // in debug reset grid.debugIt
-   if constexpr (debug){ grid.debugIt = getBitset.begin(); }
+   if constexpr (debug){ grid.debugIt = tileRules->getIndex.begin(); }
 
    // reset grid
    grid.reset();
@@ -1,12 +1,14 @@
-#include<bitset>
 #include<iostream>
 #include<vector>
 
 #include"raylib.h"
 
 #include"analyzeTiles.h"
+#include"config.h"
 #include"grid.h"
 #include"menu.h"
+#include"overlay.h"
+#include"profile.h"
 #include"storage.h"
 #include"utils.h"
 
@@ -17,20 +19,30 @@
 // set up global pointers
 Grid* gridPtr;
 MenuControl* menusPtr;
+PerfOverlay* overlayPtr;
 
 void UpdateDrawFrame();
 
-int main(){
+int main(int argc, char* argv[]){
+
+    // grid and window size, speed and tileset from the command line or a config file
+    Config config;
+    config.parse(argc, argv);
+    config.apply();
 
     InitWindow(screenWidth, screenHeight, "Wavefunction Collapse");
 
-    // chose random tileset
+    // chose random tileset, unless one was given
     tilesetDir = setUpTileset();
+    if (!config.tileset.empty()){ tilesetDir = config.tileset; }
 
     // create grid with tileset and data sheet
     Grid grid;
     gridPtr = &grid;
 
+    // repeatable maps
+    if (config.seeded){ grid.solver->seed(config.seed); }
+
     // create controlls and tile select menu
     MenuControl menus(
         createControlsMenu(screenWidth-700.0f, screenHeight-105.0f, grid, &Grid::reset, grid.running, grid.updateSpeed),
@@ -38,6 +50,10 @@ int main(){
     );
     menusPtr = &menus;
 
+    // performance overlay, toggled with F3
+    PerfOverlay overlay(grid);
+    overlayPtr = &overlay;
+
     // Web version uses emscripten function
     #ifdef PLATFORM_WEB
         emscripten_set_main_loop(UpdateDrawFrame, fps, 1);
@@ -46,7 +62,12 @@ int main(){
         while(!WindowShouldClose()){ UpdateDrawFrame(); }
     #endif
 
-    // unload all fonts and textures
+    if (!config.profile.empty() && !writeProfile(config.profile, std::cout)){
+        std::cerr << "Could not write \"" << config.profile << "\".\n";
+    }
+
+    // unload the grid's canvas, all fonts and textures
+    grid.unloadCanvas();
     textureStore.unloadAll();
     fontStore.unloadAll();
 
@@ -58,6 +79,8 @@ int main(){
 // main loop funciton
 void UpdateDrawFrame(){
 
+    WFC_ZONE("UpdateDrawFrame");
+
     // add elapsed time since last update
     sinceLastUpdate += GetFrameTime();
 
@@ -68,11 +91,18 @@ void UpdateDrawFrame(){
     ClearBackground(RAYWHITE);
 
     // draw grid and menu
+    double drawStart = GetTime();
     gridPtr->draw();
+    double drawSeconds = GetTime() - drawStart;
     menusPtr->draw();
 
     // calculate and set next grid updates
+    double updateStart = GetTime();
     gridPtr->update();
+    double updateSeconds = GetTime() - updateStart;
+
+    overlayPtr->record(updateSeconds, drawSeconds);
+    overlayPtr->draw();
 
     EndDrawing();
 }
\ No newline at end of file
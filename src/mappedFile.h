@@ -0,0 +1,68 @@
+#pragma once
+
+#include<cstddef>
+#include<fstream>
+#include<iterator>
+#include<string>
+#include<vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+   #include<fcntl.h>
+   #include<sys/mman.h>
+   #include<sys/stat.h>
+   #include<unistd.h>
+#endif
+
+// read-only view of a whole file, memory mapped where the platform allows it
+struct MappedFile{
+   const char* data{nullptr};
+   std::size_t size{0};
+
+   // false if the file could not be read (data is also null for an empty file)
+   bool open{false};
+
+   explicit MappedFile(const std::string& path);
+   ~MappedFile();
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+   // contents read into memory on other platforms (e.g. emscripten's virtual file system)
+   std::vector<char> buffer;
+   bool mapped{false};
+};
+
+MappedFile::MappedFile(const std::string& path){
+
+   #if defined(__unix__) || defined(__APPLE__)
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0){ return; }
+
+      struct stat info{};
+      if (::fstat(fd, &info) == 0 && info.st_size > 0){
+         void* address = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+         if (address != MAP_FAILED){
+            data = static_cast<const char*>(address);
+            size = static_cast<std::size_t>(info.st_size);
+            mapped = true;
+            open = true;
+         }
+      }
+      ::close(fd);
+      if (mapped){ return; }
+   #endif
+
+   std::ifstream file(path, std::ios::binary);
+   if (!file.is_open()){ return; }
+   buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+   data = buffer.data();
+   size = buffer.size();
+   open = true;
+}
+
+MappedFile::~MappedFile(){
+   #if defined(__unix__) || defined(__APPLE__)
+      if (mapped){ ::munmap(const_cast<char*>(data), size); }
+   #endif
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include<algorithm>
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<cstdio>
+#include<string>
+#include<utility>
+#include<vector>
+
+#include"raylib.h"
+
+#include"globals.h"
+#include"grid.h"
+#include"storage.h"
+
+// Performance of the viewer drawn over the grid, shown and hidden with toggleKey: collapses/sec,
+// propagation steps per collapse, time of a frame spent in the grid's update and draw, contradictions
+// and resets, and how many uncollapsed cells have each number of possibilities (entropyList buckets).
+// Everything comes from the solver's thread (SolverThread), the overlay never reads the solver.
+// Rates are averaged over `period` seconds so they can be read while changing weights.
+struct PerfOverlay{
+
+   Grid& grid;
+
+   bool visible{false};
+   int toggleKey{KEY_F3};
+
+   // seconds between updates of the averaged values
+   double period{0.5};
+
+   // alpha_beta font by Brian Kent (AEnigma)
+   Font& font{fontStore.getRef("fonts/alpha_beta.png")};
+
+   float scale{2.0f};
+   float fontSize{font.baseSize*scale};
+   float spacing{1.0f*scale};
+
+   // panel in the top right corner
+   Rectangle bounds{};
+
+   explicit PerfOverlay(Grid& grid): grid(grid){};
+
+   // add the time of one frame's grid update and draw, in seconds (also checks toggleKey)
+   void record(double updateSeconds, double drawSeconds);
+
+   void draw();
+
+private:
+
+   // sums since the averaged values were last updated
+   double elapsed{0.0};
+   double updateSum{0.0};
+   double drawSum{0.0};
+   std::size_t frames{0};
+   std::uint64_t lastCollapses{0};
+   std::uint64_t lastSteps{0};
+
+   // averaged values shown
+   double collapsesPerSecond{0.0};
+   double stepsPerCollapse{0.0};
+   double updateMs{0.0};
+   double drawMs{0.0};
+
+   // uncollapsed cells by number of possibilities
+   std::vector<std::size_t> pending;
+};
+
+void PerfOverlay::record(double updateSeconds, double drawSeconds){
+
+   if (IsKeyPressed(toggleKey)){ visible = !visible; }
+
+   elapsed += GetFrameTime();
+   updateSum += updateSeconds;
+   drawSum += drawSeconds;
+   frames++;
+
+   if (elapsed < period){ return; }
+
+   // the solver's totals only grow, even across resets, but changing tileset makes a new solver
+   std::uint64_t totalCollapses = grid.solving.collapses.load(std::memory_order_relaxed);
+   std::uint64_t totalSteps = grid.solving.propagationSteps.load(std::memory_order_relaxed);
+   if (totalCollapses < lastCollapses || totalSteps < lastSteps){ lastCollapses = lastSteps = 0; }
+   std::uint64_t collapses = totalCollapses - lastCollapses;
+   std::uint64_t steps = totalSteps - lastSteps;
+
+   collapsesPerSecond = static_cast<double>(collapses)/elapsed;
+   stepsPerCollapse = collapses > 0 ? static_cast<double>(steps)/static_cast<double>(collapses) : 0.0;
+   updateMs = updateSum/static_cast<double>(frames)*1e3;
+   drawMs = drawSum/static_cast<double>(frames)*1e3;
+
+   lastCollapses = totalCollapses;
+   lastSteps = totalSteps;
+
+   // ask the solver's thread for the cells left, it answers between two steps
+   if (visible && grid.solving.running()){
+      SolverCommand command;
+      command.kind = SolverCommand::Kind::pending;
+      grid.solving.send(std::move(command));
+   }
+
+   elapsed = 0.0;
+   updateSum = 0.0;
+   drawSum = 0.0;
+   frames = 0;
+}
+
+void PerfOverlay::draw(){
+
+   if (!visible){ return; }
+
+   // latest answer of the solver's thread
+   std::vector<std::size_t> cells;
+   while (grid.solving.pending.pop(cells)){ pending = std::move(cells); }
+
+   char line[64];
+   std::vector<std::string> lines;
+   auto add = [&](const char* format, auto... values){
+      std::snprintf(line, sizeof(line), format, values...);
+      lines.emplace_back(line);
+   };
+
+   add("collapses/s   %.0f", collapsesPerSecond);
+   add("steps/collapse %.1f", stepsPerCollapse);
+   add("update  %.2f ms", updateMs);
+   add("draw    %.2f ms", drawMs);
+   add("contradictions %llu", static_cast<unsigned long long>(grid.solving.contradictions.load(std::memory_order_relaxed)));
+   add("resets  %llu", static_cast<unsigned long long>(grid.solving.resets.load(std::memory_order_relaxed)));
+   add("cells by possibilities");
+
+   float lineHeight = fontSize + spacing;
+   float padding = 4.0f*scale;
+   float histogramHeight = 40.0f*scale;
+
+   bounds.width = 0.0f;
+   for (const std::string& text : lines){ bounds.width = std::max(bounds.width, MeasureTextEx(font, text.c_str(), fontSize, spacing).x); }
+   bounds.width += 2.0f*padding;
+   bounds.height = static_cast<float>(lines.size())*lineHeight + histogramHeight + 3.0f*padding;
+   bounds.x = static_cast<float>(screenWidth) - bounds.width - 10.0f;
+   bounds.y = 10.0f;
+
+   DrawRectangleRec(bounds, Fade(BLACK, 0.7f));
+
+   Vector2 pos{bounds.x + padding, bounds.y + padding};
+   for (const std::string& text : lines){
+      DrawTextEx(font, text.c_str(), pos, fontSize, spacing, WHITE);
+      pos.y += lineHeight;
+   }
+
+   // one bar per number of possibilities from 1 to the most any cell has, scaled to the fullest bucket
+   std::size_t highest{1}, fullest{1};
+   for (std::size_t n=1; n<pending.size(); n++){
+      if (pending[n] > 0){ highest = n; }
+      fullest = std::max(fullest, pending[n]);
+   }
+
+   Rectangle area{bounds.x + padding, pos.y + padding, bounds.width - 2.0f*padding, histogramHeight};
+   DrawRectangleLinesEx(area, 1.0f, GRAY);
+
+   float barWidth = area.width/static_cast<float>(highest);
+   for (std::size_t n=1; n<=highest && n<pending.size(); n++){
+      float height = area.height*static_cast<float>(pending[n])/static_cast<float>(fullest);
+      DrawRectangleRec({area.x + static_cast<float>(n-1)*barWidth, area.y + area.height - height, std::max(barWidth - 1.0f, 1.0f), height}, n == 1 ? ORANGE : SKYBLUE);
+   }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include<algorithm>
+#include<condition_variable>
+#include<cstddef>
+#include<deque>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<utility>
+#include<vector>
+
+// Work-stealing thread pool. Every worker has its own deque of tasks: it runs its newest task first
+// (whose data is likely still in its cache), and when it has none takes the oldest task of another
+// worker. Tasks get the index of the worker running them, so callers can keep one context (solver,
+// buffers) per worker instead of sharing any.
+struct ThreadPool{
+
+   using Task = std::function<void(std::size_t worker)>;
+
+   // start threads workers (at least one)
+   explicit ThreadPool(std::size_t threads=std::thread::hardware_concurrency());
+
+   // finish every queued task, then stop the workers
+   ~ThreadPool();
+
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   // queue a task. From a task, it goes to the deque of the worker running it
+   void submit(Task task);
+
+   // block until every submitted task has finished, including the ones they submitted
+   // (not to be called from a task)
+   void wait();
+
+   // number of workers
+   std::size_t size() const { return workers.size(); }
+
+private:
+
+   // tasks of one worker, newest at the back
+   struct Queue{
+      std::mutex mutex;
+      std::deque<Task> tasks;
+   };
+
+   std::vector<std::unique_ptr<Queue>> queues;
+   std::vector<std::thread> workers;
+
+   // guards the counters below, workers sleep on wake while there is no task
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable done;
+
+   // tasks in the deques not yet claimed by a worker, and tasks submitted but not finished
+   std::size_t queued{0};
+   std::size_t pending{0};
+
+   // set by the destructor
+   bool stopping{false};
+
+   // deque for tasks submitted from outside the pool
+   std::size_t nextQueue{0};
+
+   // claim tasks until the pool stops
+   void run(std::size_t worker);
+
+   // pop the newest task of worker, or steal the oldest of another one (false if there is none)
+   bool take(std::size_t worker, Task& task);
+};
+
+// pool and index of the worker running on this thread (none outside of pools)
+thread_local const ThreadPool* currentPool{nullptr};
+thread_local std::size_t currentWorker{0};
+
+ThreadPool::ThreadPool(std::size_t threads){
+
+   threads = std::max<std::size_t>(threads, 1);
+
+   for (std::size_t i=0; i<threads; i++){ queues.push_back(std::make_unique<Queue>()); }
+   for (std::size_t i=0; i<threads; i++){ workers.emplace_back([this, i]{ run(i); }); }
+}
+
+ThreadPool::~ThreadPool(){
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+   }
+   wake.notify_all();
+
+   for (std::thread& worker : workers){ worker.join(); }
+}
+
+void ThreadPool::submit(Task task){
+
+   std::size_t queue;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue = currentPool == this ? currentWorker : nextQueue++ % queues.size();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+      queues[queue]->tasks.push_back(std::move(task));
+   }
+
+   // only counted once it can be found, so a claimed task is always in some deque
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      queued++;
+      pending++;
+   }
+   wake.notify_one();
+}
+
+void ThreadPool::wait(){
+   std::unique_lock<std::mutex> lock(mutex);
+   done.wait(lock, [this]{ return pending == 0; });
+}
+
+void ThreadPool::run(std::size_t worker){
+
+   currentPool = this;
+   currentWorker = worker;
+
+   Task task;
+
+   while (true){
+
+      // claim a task, or stop once there is none left
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         wake.wait(lock, [this]{ return stopping || queued > 0; });
+         if (queued == 0){ return; }
+         queued--;
+      }
+
+      // another worker may take the task we claimed first, but then there is one for us left elsewhere
+      while (!take(worker, task)){ std::this_thread::yield(); }
+
+      task(worker);
+      task = nullptr;
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         if (--pending == 0){ done.notify_all(); }
+      }
+   }
+}
+
+bool ThreadPool::take(std::size_t worker, Task& task){
+
+   for (std::size_t i=0; i<queues.size(); i++){
+
+      Queue& queue = *queues[(worker + i)%queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty()){ continue; }
+
+      // own deque from the back, others from the front
+      if (i == 0){
+         task = std::move(queue.tasks.back());
+         queue.tasks.pop_back();
+      }
+      else {
+         task = std::move(queue.tasks.front());
+         queue.tasks.pop_front();
+      }
+      return true;
+   }
+
+   return false;
+}
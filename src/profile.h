@@ -0,0 +1,386 @@
+#pragma once
+
+#include<algorithm>
+#include<array>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<fstream>
+#include<iomanip>
+#include<memory>
+#include<mutex>
+#include<ostream>
+#include<string>
+#include<vector>
+
+// Instrumentation of the hot paths: timed zones (WFC_ZONE times the scope it is declared in) and
+// counters of every solve, kept per thread without locks. Built in with WFC_PROFILE=1 (cmake
+// -DWFC_PROFILE=ON, make WFC_PROFILE=TRUE); otherwise the macros expand to nothing and nothing is
+// measured. writeProfile() exports a Chrome trace (chrome://tracing, ui.perfetto.dev) and a summary table.
+#ifndef WFC_PROFILE
+   #define WFC_PROFILE 0
+#endif
+
+// the cycle counter is read about twice as fast as steady_clock, ticks become ns when exported
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+   #include<x86intrin.h>
+   std::int64_t profileTicks(){ return static_cast<std::int64_t>(__rdtsc()); }
+#else
+   std::int64_t profileTicks(){ return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+#endif
+
+constexpr bool profiling{WFC_PROFILE != 0};
+
+// counters of a solve, which runs from one reset of a solver to the next (resets before its
+// first collapse, e.g. creating and then seeding a solver, count towards the same solve)
+enum class Counter : std::size_t {
+   collapses,        // tiles chosen
+   propagations,     // propagation passes (one per collapse, constraint or undone decision)
+   cellsVisited,     // cells taken from the propagation queue (tile bans with support propagation)
+   queuePeak,        // most cells queued at once (a maximum, not a sum)
+   bitsRemoved,      // tiles removed from cells
+   contradictions,   // propagations which emptied a cell
+   backtracks,       // decisions undone
+   resets,           // resets of the wave
+   count
+};
+
+constexpr std::size_t nCounters{static_cast<std::size_t>(Counter::count)};
+constexpr std::array<const char*, nCounters> counterNames{"collapses", "propagations", "cells_visited", "queue_peak", "bits_removed", "contradictions", "backtracks", "resets"};
+
+using Counters = std::array<std::uint64_t, nCounters>;
+
+// one run of a zone, in ticks since the profiler started
+struct ZoneEvent{
+   std::uint32_t zone;
+   std::int64_t start;
+   std::int64_t duration;
+};
+
+// counters of one finished solve
+struct SolveEvent{
+   std::int64_t end;
+   Counters counters;
+};
+
+// totals of one zone, in ticks
+struct ZoneStats{
+   std::uint64_t calls{0};
+   std::int64_t total{0};
+   std::int64_t max{0};
+};
+
+// everything one thread measured, only written by that thread
+struct ThreadProfile{
+   std::uint32_t id{0};
+
+   // in the order they ended, up to Profiler::maxEvents each (later ones are only in the totals)
+   std::vector<ZoneEvent> events;
+   std::vector<SolveEvent> solves;
+   std::uint64_t dropped{0};
+
+   // by zone id
+   std::vector<ZoneStats> zones;
+
+   // solve in progress, and sums and maxima of the finished ones
+   Counters current{};
+   Counters totals{};
+   Counters peaks{};
+   std::uint64_t solveCount{0};
+};
+
+// one row of the zone summary, in ns
+struct ZoneSummary{
+   std::string name;
+   std::uint64_t calls{0};
+   double total{0.0};
+   double max{0.0};
+};
+
+// Owner of the profiles of every thread. Reading them (summary, writeTrace) is meant for once the
+// measured work has stopped, e.g. at the end of a tool or between frames of the viewer.
+struct Profiler{
+
+   // events kept per thread
+   std::size_t maxEvents{1u << 18};
+
+   Profiler(): origin(std::chrono::steady_clock::now()), originTicks(profileTicks()){};
+
+   // id of a zone name, once per call site
+   std::uint32_t zone(const char* name);
+
+   // profile of the calling thread, created on first use
+   ThreadProfile& thread();
+
+   // ticks since the profiler was created
+   std::int64_t now() const { return profileTicks() - originTicks; }
+
+   // length of a tick, measured over the time since the profiler was created
+   double nsPerTick() const;
+
+   // record a run of zone on the calling thread
+   void record(std::uint32_t zone, std::int64_t start, std::int64_t end);
+
+   // finish the solve in progress on the calling thread (nothing if it collapsed nothing yet)
+   void endSolve(){ endSolve(thread()); }
+
+   // zones of every thread, slowest in total first
+   std::vector<ZoneSummary> zoneSummary();
+
+   // sums and maxima of the counters of every solve (solves in progress included), and events dropped
+   void counterSummary(Counters& totals, Counters& peaks, std::uint64_t& solves, std::uint64_t& dropped);
+
+   // Chrome trace event format: a complete event per zone run, a counter event per solve
+   void writeTrace(std::ostream& out);
+
+   // zones and counters as text tables
+   void writeSummary(std::ostream& out);
+
+private:
+   std::chrono::steady_clock::time_point origin;
+   std::int64_t originTicks;
+
+   // guards names and threads
+   std::mutex mutex;
+   std::vector<std::string> names;
+   std::vector<std::unique_ptr<ThreadProfile>> threads;
+
+   void endSolve(ThreadProfile& profile);
+};
+
+Profiler profiler;
+
+// profile of this thread in profiler (set on first use)
+thread_local ThreadProfile* threadProfile{nullptr};
+
+// records the time from its construction to the end of its scope
+struct ProfileZone{
+   explicit ProfileZone(std::uint32_t zone): zone(zone), start(profiler.now()){};
+   ~ProfileZone(){ profiler.record(zone, start, profiler.now()); }
+
+   ProfileZone(const ProfileZone&) = delete;
+   ProfileZone& operator=(const ProfileZone&) = delete;
+
+   std::uint32_t zone;
+   std::int64_t start;
+};
+
+#if WFC_PROFILE
+   #define WFC_PROFILE_CONCAT_(a, b) a##b
+   #define WFC_PROFILE_CONCAT(a, b) WFC_PROFILE_CONCAT_(a, b)
+
+   // time the rest of the scope as zone name (a string literal)
+   #define WFC_ZONE(name) \
+      static const std::uint32_t WFC_PROFILE_CONCAT(wfcZoneId, __LINE__) = profiler.zone(name); \
+      ProfileZone WFC_PROFILE_CONCAT(wfcZone, __LINE__)(WFC_PROFILE_CONCAT(wfcZoneId, __LINE__))
+
+   // add n to a counter of the current solve, or raise it to value
+   #define WFC_COUNT(counter, n) (profiler.thread().current[static_cast<std::size_t>(Counter::counter)] += (n))
+   #define WFC_PEAK(counter, value) \
+      do { std::uint64_t& wfcPeak = profiler.thread().current[static_cast<std::size_t>(Counter::counter)]; \
+           wfcPeak = std::max<std::uint64_t>(wfcPeak, (value)); } while (false)
+
+   // the solve of this thread ends here, its counters are recorded
+   #define WFC_END_SOLVE() profiler.endSolve()
+#else
+   #define WFC_ZONE(name)
+   #define WFC_COUNT(counter, n)
+   #define WFC_PEAK(counter, value)
+   #define WFC_END_SOLVE()
+#endif
+
+std::uint32_t Profiler::zone(const char* name){
+   std::lock_guard<std::mutex> lock(mutex);
+   names.emplace_back(name);
+   return static_cast<std::uint32_t>(names.size() - 1);
+}
+
+double Profiler::nsPerTick() const {
+
+   auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+   std::int64_t ticks = now();
+   return ticks > 0 ? static_cast<double>(ns)/static_cast<double>(ticks) : 1.0;
+}
+
+ThreadProfile& Profiler::thread(){
+
+   if (!threadProfile){
+      std::lock_guard<std::mutex> lock(mutex);
+      threads.push_back(std::make_unique<ThreadProfile>());
+      threads.back()->id = static_cast<std::uint32_t>(threads.size() - 1);
+
+      // never reallocated while measuring
+      threads.back()->events.reserve(maxEvents);
+      threadProfile = threads.back().get();
+   }
+   return *threadProfile;
+}
+
+void Profiler::record(std::uint32_t zone, std::int64_t start, std::int64_t end){
+
+   ThreadProfile& profile = thread();
+
+   if (zone >= profile.zones.size()){ profile.zones.resize(zone + 1); }
+   ZoneStats& stats = profile.zones[zone];
+   stats.calls++;
+   stats.total += end - start;
+   stats.max = std::max(stats.max, end - start);
+
+   if (profile.events.size() < maxEvents){ profile.events.push_back({zone, start, end - start}); }
+   else { profile.dropped++; }
+}
+
+void Profiler::endSolve(ThreadProfile& profile){
+
+   if (profile.current[static_cast<std::size_t>(Counter::collapses)] == 0){ return; }
+
+   for (std::size_t c=0; c<nCounters; c++){
+      profile.totals[c] += profile.current[c];
+      profile.peaks[c] = std::max(profile.peaks[c], profile.current[c]);
+   }
+   profile.solveCount++;
+
+   if (profile.solves.size() < maxEvents){ profile.solves.push_back({now(), profile.current}); }
+   else { profile.dropped++; }
+
+   profile.current = {};
+}
+
+std::vector<ZoneSummary> Profiler::zoneSummary(){
+
+   std::lock_guard<std::mutex> lock(mutex);
+
+   double scale = nsPerTick();
+
+   std::vector<ZoneSummary> rows(names.size());
+   for (std::size_t z=0; z<names.size(); z++){ rows[z].name = names[z]; }
+
+   for (const auto& profile : threads){
+      for (std::size_t z=0; z<profile->zones.size(); z++){
+         const ZoneStats& stats = profile->zones[z];
+         rows[z].calls += stats.calls;
+         rows[z].total += static_cast<double>(stats.total)*scale;
+         rows[z].max = std::max(rows[z].max, static_cast<double>(stats.max)*scale);
+      }
+   }
+
+   // zones which never ran are left out
+   rows.erase(std::remove_if(rows.begin(), rows.end(), [](const ZoneSummary& row){ return row.calls == 0; }), rows.end());
+   std::stable_sort(rows.begin(), rows.end(), [](const ZoneSummary& a, const ZoneSummary& b){ return a.total > b.total; });
+   return rows;
+}
+
+void Profiler::counterSummary(Counters& totals, Counters& peaks, std::uint64_t& solves, std::uint64_t& dropped){
+
+   std::lock_guard<std::mutex> lock(mutex);
+
+   totals = {};
+   peaks = {};
+   solves = 0;
+   dropped = 0;
+
+   for (const auto& profile : threads){
+
+      // a solve in progress counts as finished once it collapsed a tile
+      solves += profile->solveCount + (profile->current[static_cast<std::size_t>(Counter::collapses)] > 0);
+      dropped += profile->dropped;
+
+      for (std::size_t c=0; c<nCounters; c++){
+         totals[c] += profile->totals[c] + profile->current[c];
+         peaks[c] = std::max({peaks[c], profile->peaks[c], profile->current[c]});
+      }
+   }
+}
+
+void Profiler::writeTrace(std::ostream& out){
+
+   std::lock_guard<std::mutex> lock(mutex);
+
+   // times in µs with ns digits
+   double scale = nsPerTick()/1000.0;
+   auto micros = [scale](std::int64_t ticks){ return static_cast<double>(ticks)*scale; };
+   out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+
+   bool first{true};
+   auto separator = [&]() -> std::ostream& {
+      out << (first ? "" : ",\n");
+      first = false;
+      return out;
+   };
+
+   for (const auto& profile : threads){
+
+      separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << profile->id
+                  << ", \"args\": {\"name\": \"thread " << profile->id << "\"}}";
+
+      for (const ZoneEvent& event : profile->events){
+         separator() << "{\"name\": \"" << names[event.zone] << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << profile->id
+                     << ", \"ts\": " << micros(event.start) << ", \"dur\": " << micros(event.duration) << "}";
+      }
+
+      // counter tracks are per name, one per thread
+      auto counters = [&](std::int64_t time, const Counters& values){
+         separator() << "{\"name\": \"solve (thread " << profile->id << ")\", \"ph\": \"C\", \"pid\": 1, \"tid\": " << profile->id
+                     << ", \"ts\": " << micros(time) << ", \"args\": {";
+         for (std::size_t c=0; c<nCounters; c++){ out << (c > 0 ? ", " : "") << "\"" << counterNames[c] << "\": " << values[c]; }
+         out << "}}";
+      };
+      for (const SolveEvent& solve : profile->solves){ counters(solve.end, solve.counters); }
+      if (profile->current != Counters{}){ counters(now(), profile->current); }
+   }
+
+   out << "\n]}\n";
+   out << std::defaultfloat;
+}
+
+void Profiler::writeSummary(std::ostream& out){
+
+   std::vector<ZoneSummary> zones = zoneSummary();
+
+   out << std::fixed << std::setprecision(3)
+       << std::left << std::setw(24) << "zone" << std::right << std::setw(12) << "calls" << std::setw(14) << "total ms"
+       << std::setw(12) << "mean us" << std::setw(12) << "max us" << "\n";
+
+   for (const ZoneSummary& row : zones){
+      out << std::left << std::setw(24) << row.name << std::right << std::setw(12) << row.calls
+          << std::setw(14) << row.total/1e6
+          << std::setw(12) << row.total/1e3/static_cast<double>(row.calls)
+          << std::setw(12) << row.max/1e3 << "\n";
+   }
+
+   Counters totals, peaks;
+   std::uint64_t solves, dropped;
+   counterSummary(totals, peaks, solves, dropped);
+
+   out << "\n" << std::left << std::setw(24) << "counter" << std::right << std::setw(14) << "total"
+       << std::setw(14) << "per solve" << std::setw(14) << "max solve" << "\n";
+
+   // the sum of queue peaks means nothing, their mean per solve does
+   for (std::size_t c=0; c<nCounters; c++){
+      out << std::left << std::setw(24) << counterNames[c] << std::right << std::setw(14);
+      if (c == static_cast<std::size_t>(Counter::queuePeak)){ out << "-"; }
+      else { out << totals[c]; }
+      out << std::setw(14) << (solves > 0 ? static_cast<double>(totals[c])/static_cast<double>(solves) : 0.0)
+          << std::setw(14) << peaks[c] << "\n";
+   }
+
+   std::uint64_t propagations = totals[static_cast<std::size_t>(Counter::propagations)];
+   out << solves << " solves, "
+       << (propagations > 0 ? static_cast<double>(totals[static_cast<std::size_t>(Counter::cellsVisited)])/static_cast<double>(propagations) : 0.0)
+       << " cells visited per propagation";
+   if (dropped > 0){ out << ", " << dropped << " events left out of the trace"; }
+   out << "\n";
+
+   out << std::defaultfloat;
+}
+
+// write the Chrome trace to path and the summary to summary, false if path can't be written
+bool writeProfile(const std::string& path, std::ostream& summary){
+
+   std::ofstream file(path);
+   if (!file.is_open()){ return false; }
+
+   profiler.writeTrace(file);
+   profiler.writeSummary(summary);
+   return static_cast<bool>(file);
+}
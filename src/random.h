@@ -0,0 +1,89 @@
+#pragma once
+
+#include<cstdint>
+#include<limits>
+
+// Fast random number generator with a fixed algorithm (xoshiro256**, seeded through splitmix64),
+// so the same seed gives the same numbers with every compiler and standard library.
+// Only integer arithmetic is used to draw indexes, unlike the std distributions whose output is
+// implementation defined.
+struct Random{
+
+   using result_type = std::uint64_t;
+
+   // generator state, never all zero
+   std::uint64_t state[4];
+
+   explicit Random(std::uint64_t seed=0){ this->seed(seed); }
+
+   // restart the sequence from seed
+   void seed(std::uint64_t seed);
+
+   // next 64 random bits
+   std::uint64_t next();
+   std::uint64_t operator()(){ return next(); }
+
+   static constexpr std::uint64_t min(){ return 0; }
+   static constexpr std::uint64_t max(){ return std::numeric_limits<std::uint64_t>::max(); }
+
+   // uniform integer in [0, n), n > 0
+   std::uint64_t below(std::uint64_t n);
+
+   // uniform double in [0, 1) (53 random bits)
+   double uniform();
+
+};
+
+void Random::seed(std::uint64_t seed){
+
+   // splitmix64 spreads any seed (including 0) over the whole state
+   for (std::uint64_t& word : state){
+      std::uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      word = z ^ (z >> 31);
+   }
+}
+
+std::uint64_t Random::next(){
+
+   auto rotl = [](std::uint64_t x, int k){ return (x << k) | (x >> (64 - k)); };
+
+   std::uint64_t result = rotl(state[1] * 5, 7) * 9;
+   std::uint64_t t = state[1] << 17;
+
+   state[2] ^= state[0];
+   state[3] ^= state[1];
+   state[1] ^= state[2];
+   state[0] ^= state[3];
+
+   state[2] ^= t;
+   state[3] = rotl(state[3], 45);
+
+   return result;
+}
+
+std::uint64_t Random::below(std::uint64_t n){
+
+   // reject the lowest (2^64 mod n) values, so every remainder is equally likely
+   std::uint64_t threshold = (0 - n) % n;
+
+   while (true){
+      std::uint64_t r = next();
+      if (r >= threshold){ return r % n; }
+   }
+}
+
+double Random::uniform(){
+   return static_cast<double>(next() >> 11) * 0x1.0p-53;
+}
+
+// seed of the cell (x,y) of a grid of seeds (e.g. chunks of a world), unrelated to its neighbours'
+std::uint64_t mixSeed(std::uint64_t seed, int x, int y){
+
+   // mix seed and both coordinates through the generator's seeding
+   std::uint64_t packed = static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32 | static_cast<std::uint32_t>(y);
+   Random mix(seed);
+   mix.seed(mix.next() ^ packed);
+   return mix.next();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include<atomic>
+#include<cstddef>
+#include<utility>
+#include<vector>
+
+// Lock-free ring buffer for one producer thread and one consumer thread. The producer only writes
+// tail and the consumer only writes head, each publishing its slots with a release store, so neither
+// ever waits on the other: push fails when the ring is full and pop when it is empty. The capacity
+// is rounded up to a power of two so positions wrap with a mask.
+template <typename T>
+struct SpscRing{
+
+   explicit SpscRing(std::size_t capacity);
+
+   SpscRing(const SpscRing&) = delete;
+   SpscRing& operator=(const SpscRing&) = delete;
+
+   // producer: move value in, false (leaving value) if the ring is full
+   bool push(T& value);
+   bool push(T&& value){ return push(value); }
+
+   // consumer: move the oldest value out, false if the ring is empty
+   bool pop(T& value);
+
+   // consumer: drop everything pushed so far
+   void clear();
+
+   // either side, only a snapshot while the other side runs
+   bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+   std::size_t capacity() const { return slots.size(); }
+
+private:
+
+   std::vector<T> slots;
+   std::size_t mask;
+
+   // own cache lines, so the two threads don't invalidate each other's counter
+   static constexpr std::size_t cacheLine{64};
+   alignas(cacheLine) std::atomic<std::size_t> head{0};   // next slot to pop, written by the consumer
+   alignas(cacheLine) std::atomic<std::size_t> tail{0};   // next slot to push, written by the producer
+};
+
+template <typename T>
+SpscRing<T>::SpscRing(std::size_t capacity){
+
+   std::size_t size{1};
+   while (size < capacity){ size *= 2; }
+
+   slots.resize(size);
+   mask = size - 1;
+}
+
+template <typename T>
+bool SpscRing<T>::push(T& value){
+
+   std::size_t position = tail.load(std::memory_order_relaxed);
+   if (position - head.load(std::memory_order_acquire) == slots.size()){ return false; }
+
+   slots[position & mask] = std::move(value);
+   tail.store(position + 1, std::memory_order_release);
+
+   return true;
+}
+
+template <typename T>
+bool SpscRing<T>::pop(T& value){
+
+   std::size_t position = head.load(std::memory_order_relaxed);
+   if (position == tail.load(std::memory_order_acquire)){ return false; }
+
+   value = std::move(slots[position & mask]);
+   head.store(position + 1, std::memory_order_release);
+
+   return true;
+}
+
+template <typename T>
+void SpscRing<T>::clear(){
+
+   T value;
+   while (pop(value)){}
+}
@@ -139,8 +139,8 @@ SectionRange2::SectionRange2(float x, float y, std::size_t tileIndex, int min, i
    bounds = {x,y - leftButton.bounds.height*0.5f,leftButton.bounds.width*4.0f,leftButton.bounds.height};
 
    // fill controlledWeights
-   for (std::size_t i=0; i<symmetryIndex[tileIndex]; i++){
-      controlledWeights.push_back(&currentWeights[nonRotatingIndex[tileIndex] + i]);
+   for (std::size_t i=0; i<tileRules->symmetryIndex[tileIndex]; i++){
+      controlledWeights.push_back(&currentWeights[tileRules->nonRotatingIndex.at(tileIndex) + i]);
    }
 
    // reduce font size
@@ -161,7 +161,7 @@ void SectionRange2::display(){
    messagePos = {bounds.x + 0.5f*bounds.width - 0.5f*textSize.x, bounds.y + 0.5f*bounds.height - 0.5f*textSize.y};
 
    // If tile is currently turned off, grey out controlls
-   if ( weightSwitch[nonRotatingIndex[tileIndex]] == 0){
+   if ( weightSwitch[tileRules->nonRotatingIndex.at(tileIndex)] == 0){
       rightButton.display_grayed();
       leftButton.display_grayed();
    }
@@ -467,10 +467,10 @@ void SectionTiles::createTileButtons(){
    int i{0};
 
    // loop through tile ids
-   for (const auto& [rotatingId,nonRotatingId] : nonRotatingIndex ){
+   for (const auto& [rotatingId,nonRotatingId] : tileRules->nonRotatingIndex ){
       
       // create tile button
-      tileButtons.push_back(ButtonTile(*grid.texture, startX, startY, scale, rotatable ? rotatingId : nonRotatingId, rotatingId));
+      tileButtons.push_back(ButtonTile(*grid.texture, startX, startY, scale, tileRules->rotatable ? rotatingId : nonRotatingId, rotatingId));
 
       // create tile weight controls
       weightControls.push_back(SectionRange2(startX2, startY2, rotatingId, 1, 200, scale/2.0f));
@@ -0,0 +1,77 @@
+#pragma once
+
+#include<bit>
+#include<cstddef>
+#include<cstdint>
+
+// x86 vector kernels are compiled for AVX2 and only called if the CPU has it.
+// Other targets (e.g. emscripten, ARM, MSVC) always use the scalar kernel
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+   #define WFC_SIMD_X86 1
+   #include<immintrin.h>
+#else
+   #define WFC_SIMD_X86 0
+#endif
+
+// Union kernel of propagation: out = OR of rows[t] for every tile t in select.
+// rows holds one mask of `words` 64 bit words per tile, row t starting at rows + t*words.
+// select and out have `words` words, out is overwritten
+using UnionKernel = void(*)(const std::uint64_t* rows, std::size_t words, const std::uint64_t* select, std::uint64_t* out);
+
+void unionScalar(const std::uint64_t* rows, std::size_t words, const std::uint64_t* select, std::uint64_t* out){
+
+   for (std::size_t w=0; w<words; w++){ out[w] = 0; }
+
+   for (std::size_t i=0; i<words; i++){
+      for (std::uint64_t bits = select[i]; bits; bits &= bits-1){
+         const std::uint64_t* row = rows + (i*64 + static_cast<std::size_t>(std::countr_zero(bits)))*words;
+         for (std::size_t w=0; w<words; w++){ out[w] |= row[w]; }
+      }
+   }
+}
+
+#if WFC_SIMD_X86
+
+// rows are or-ed 4 words at a time into out
+// (no lambdas here, they would not be compiled for AVX2)
+__attribute__((target("avx2")))
+void unionAVX2(const std::uint64_t* rows, std::size_t words, const std::uint64_t* select, std::uint64_t* out){
+
+   // words left after the last full vector are or-ed one by one
+   std::size_t vectorWords = words - words%4;
+
+   for (std::size_t w=0; w<words; w++){ out[w] = 0; }
+
+   for (std::size_t i=0; i<words; i++){
+      for (std::uint64_t bits = select[i]; bits; bits &= bits-1){
+         const std::uint64_t* row = rows + (i*64 + static_cast<std::size_t>(std::countr_zero(bits)))*words;
+         for (std::size_t w=0; w<vectorWords; w+=4){
+            __m256i* sum = reinterpret_cast<__m256i*>(out + w);
+            _mm256_storeu_si256(sum, _mm256_or_si256(_mm256_loadu_si256(sum), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + w))));
+         }
+         for (std::size_t w=vectorWords; w<words; w++){ out[w] |= row[w]; }
+      }
+   }
+}
+
+#endif
+
+// pick the widest kernel the CPU supports
+UnionKernel selectUnionKernel(){
+   #if WFC_SIMD_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")){ return unionAVX2; }
+   #endif
+   return unionScalar;
+}
+
+// kernel in use, chosen once at startup (can be swapped for unionScalar, e.g. to compare timings)
+UnionKernel unionKernel{selectUnionKernel()};
+
+// name of the kernel in use
+const char* unionKernelName(){
+   #if WFC_SIMD_X86
+      if (unionKernel == unionAVX2){ return "avx2"; }
+   #endif
+   return "scalar";
+}
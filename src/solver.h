@@ -0,0 +1,1030 @@
+#pragma once
+
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<cstddef>
+#include<cstdint>
+#include<limits>
+#include<memory>
+#include<utility>
+#include<vector>
+
+#include"analyzeTiles.h"
+#include"domain.h"
+#include"entropy.h"
+#include"globals.h"
+#include"point.h"
+#include"profile.h"
+#include"random.h"
+#include"simd.h"
+#include"steps.h"
+#include"worklist.h"
+
+// propagation engines. Both reduce the wave to the same arc consistent state
+enum class Propagation{
+   bitset,  // recompute a neighbour's possibilities from the union of compat masks of the changed cell
+   support  // AC-4: count supporting tiles per cell, direction and tile, ban a tile when its count reaches 0
+};
+
+// how the next tile to collapse is chosen
+enum class Heuristic{
+   count,   // fewest possibilities, ties broken randomly
+   entropy  // lowest weighted Shannon entropy, ties broken by a small random noise
+};
+
+// state of a propagation which can stop partway (see Solver::steps)
+enum class Progress{
+   done,    // queue empty, the wave is consistent
+   paused,  // stopped at the limit, the rest is still queued
+   failed   // a cell lost its last possibility
+};
+
+// random choice of a tile, with where the trail and updates stood before it (to undo it)
+struct Decision{
+   std::size_t cell;
+   std::size_t tile;
+   std::size_t trailSize;
+   std::size_t fillingIndex;
+};
+
+// Headless wave function collapse solver, without any dependency on raylib. Holds the settings and
+// the list of collapses; the wave and the collapse/propagate logic are in DomainSolver, whose sets of
+// tiles are sized for the tileset. Create one for a tileset with makeSolver(). Every solver owns its
+// state, so solvers sharing the same rules can run on different threads.
+struct Solver{
+
+   // rules of the tileset, shared and never changed
+   std::shared_ptr<const TileRules> rules;
+
+   // number of tiles of the tileset
+   std::size_t uniqueTiles;
+
+   // weight of each tile, and tiles the wave starts with at reset (the viewer changes them from the menus)
+   std::vector<int> weights;
+   TileSet enabled;
+
+   // grid dimensions
+   int width;
+   int height;
+
+   // propagation engine in use
+   Propagation propagation;
+
+   // choice of next tile to collapse
+   Heuristic heuristic;
+
+   // decisions which can be undone per run before giving up, 0 disables backtracking
+   std::size_t backtrackLimit;
+
+   // source of every random choice. The same seed, tileset and size always give the same collapses
+   Random random;
+
+   // list of all updates in the order they were collapsed
+   std::vector<std::pair<Point,tileState>> updates;
+
+   // index of next update to fill from getNextCollapse
+   std::size_t fillingIndex{0};
+
+   // lowest fillingIndex a backtrack went back to since the viewer last caught up (max if none)
+   std::size_t rewindIndex{std::numeric_limits<std::size_t>::max()};
+
+   // flag for full collapse
+   bool collapsed{false};
+
+   // set when a tile runs out of possibilities and backtracking can't recover, cleared on reset
+   bool contradiction{false};
+
+   // number of decisions undone since reset
+   std::size_t backtracks{0};
+
+   // totals since the solver was created, never reset (shown by the viewer's performance overlay)
+   std::uint64_t totalCollapses{0};
+   std::uint64_t totalPropagationSteps{0};    // cells taken from the propagation queue (tile bans with support propagation)
+   std::uint64_t totalContradictions{0};
+   std::uint64_t totalResets{0};
+
+   Solver(std::shared_ptr<const TileRules> rules, int width, int height, Propagation propagation, Heuristic heuristic, std::size_t backtrackLimit):
+      rules(std::move(rules)), uniqueTiles(this->rules->uniqueTiles), weights(this->rules->weights), enabled(uniqueTiles, true),
+      width(width), height(height), propagation(propagation), heuristic(heuristic), backtrackLimit(backtrackLimit), random(gen.next()){};
+
+   virtual ~Solver() = default;
+
+   // simulate next collape
+   virtual bool getNextCollapse() = 0;
+
+   // the same collapses as getNextCollapse as a resumable task, suspending after every `slice` cells taken
+   // from the propagation queue (tile bans with support propagation) and after every collapse. It ends
+   // once the grid is collapsed or on a contradiction backtracking can't recover. Nothing else may change
+   // the solver while the task is suspended, and reset() abandons it (create a new one after).
+   virtual SolveSteps steps(std::size_t slice) = 0;
+
+   // collapse tile at pos to a single unique tile and propagate, backtrack on contradiction
+   virtual bool collapse(const Point& pos, std::size_t tile) = 0;
+
+   // reset wave to default state
+   virtual void reset() = 0;
+
+   // collapsed tile at position (only valid once the grid is collapsed)
+   virtual tileState tileAt(int x, int y) const = 0;
+
+   // remove every tile not in tiles from the tile at pos and propagate, false on contradiction.
+   // Used after a reset to fix tiles before solving (e.g. to match the edge of a neighbouring map)
+   virtual bool constrain(const Point& pos, const TileSet& tiles) = 0;
+
+   // most tiles a cell can hold (0 when sized at runtime)
+   virtual std::size_t capacity() const = 0;
+
+   // number of uncollapsed cells with n possibilities in cells[n] (cells is resized to uniqueTiles+1)
+   virtual void pendingCells(std::vector<std::size_t>& cells) const = 0;
+
+   // bytes reserved by the buffers of the solver
+   virtual std::size_t memory() const = 0;
+
+   // collapse until the grid is complete (true) or a contradiction is found (false)
+   bool solve();
+
+   // restart the random sequence from seed and reset
+   void seed(std::uint64_t value);
+
+   // number of cells in the grid
+   std::size_t size() const { return static_cast<std::size_t>(width)*static_cast<std::size_t>(height); }
+};
+
+// Solver with the possible tiles of each cell in a Domain<Words> (see domain.h)
+template<std::size_t Words>
+struct DomainSolver : Solver{
+
+   using Tiles = Domain<Words>;
+
+   // wave, one set of tiles per cell stored row by row with a one cell border of sentinels,
+   // so neighbours never need bounds checks. Cell (x,y) is at cell(x,y)
+   std::vector<Tiles> wave;
+
+   // number of possibilities of each cell in wave. Sentinels have 0
+   std::vector<std::uint16_t> counts;
+
+   // row length of wave (width + border)
+   std::size_t stride;
+
+   // offset in wave to the neighbour in each cardinal direction
+   std::array<std::ptrdiff_t,4> stencil;
+
+   // compat of the tileset, copied into sets of this width
+   std::array<std::vector<Tiles>,4> allowed;
+
+   // allowed as one flat table of words per direction (row t: words of allowed[d][t]), read by unionKernel
+   // (only filled for sets sized at runtime)
+   std::array<std::vector<std::uint64_t>,4> allowedRows;
+
+   // cells grouped by number of possibilities. Only keeps track of uncollapsed tiles (Heuristic::count)
+   EntropyList entropyList;
+
+   // cells ordered by weighted Shannon entropy. Only keeps track of uncollapsed tiles (Heuristic::entropy)
+   EntropyHeap entropyHeap;
+
+   // entropy heuristic: weight and weight*log(weight) of each tile, fixed at reset
+   std::vector<double> tileWeights;
+   std::vector<double> tileWeightLogWeights;
+
+   // entropy heuristic: running sums of weight and weight*log(weight) of each cell's possible tiles,
+   // and a small random noise per cell to break ties
+   std::vector<double> sumWeights;
+   std::vector<double> sumWeightLogWeights;
+   std::vector<double> noise;
+
+   // backtracking: (cell, tiles) removed from the wave since the first decision, in order
+   std::vector<std::pair<std::size_t,Tiles>> trail;
+
+   // backtracking: random choices which can still be undone
+   std::vector<Decision> decisions;
+
+   // support engine: number of tiles in the neighbour in direction d that allow tile t in cell c,
+   // stored at ((c*4)+d)*uniqueTiles + t
+   std::vector<std::uint16_t> support;
+
+   // support engine: (cell, tile) which lost a support, banned when still possible
+   std::vector<std::pair<std::size_t,std::size_t>> banStack;
+
+   // bitset engine: cells whose neighbours need to be resolved
+   WorkList toResolve;
+
+   // bitset engine: sets reused by every propagation (sets sized at runtime would allocate otherwise)
+   Tiles possible;
+   Tiles removed;
+
+   // construct solver for a tileset
+   DomainSolver(std::shared_ptr<const TileRules> rules, int width, int height, Propagation propagation, Heuristic heuristic, std::size_t backtrackLimit);
+
+   bool getNextCollapse() override;
+   SolveSteps steps(std::size_t slice) override;
+   bool collapse(const Point& pos, std::size_t tile) override;
+   void reset() override;
+   tileState tileAt(int x, int y) const override;
+   bool constrain(const Point& pos, const TileSet& tiles) override;
+   std::size_t capacity() const override { return Tiles::capacity(); }
+   void pendingCells(std::vector<std::size_t>& cells) const override;
+   std::size_t memory() const override;
+
+   // propagate effects of collapse
+   bool propagate(const Point& currentPos);
+
+   // reset entropy list (used to find next tile to collapse)
+   void resetEntropy();
+
+   // index in wave of the tile at (x,y)
+   std::size_t cell(int x, int y) const { return (static_cast<std::size_t>(y)+1)*stride + static_cast<std::size_t>(x) + 1; }
+   std::size_t cell(const Point& pos) const { return cell(pos.x, pos.y); }
+
+   // position of a cell in wave
+   Point cellPos(std::size_t cell) const { return {static_cast<int>(cell%stride) - 1, static_cast<int>(cell/stride) - 1}; }
+
+private:
+
+   // set holding only tile
+   Tiles single(std::size_t tile) const { return Tiles(uniqueTiles).set(tile); }
+
+   // weighted random choice between the possible tiles of a cell
+   std::size_t sampleTile(std::size_t cell);
+
+   // cell to collapse next and its tile
+   std::pair<std::size_t,std::size_t> choose();
+
+   // make tile the only possibility of cell and record the collapse, true if other tiles were removed
+   // and need propagating
+   bool assign(std::size_t cell, std::size_t tile);
+
+   // propagate what is queued (toResolve or banStack) for at most limit cells
+   Progress resolve(std::size_t limit);
+
+   // possible = union of the tiles allowed in direction d by every tile of a set
+   void allowedBy(const Tiles& tiles, std::size_t d, Tiles& possible) const;
+
+   // bitset engine: breadth-first propagation from a changed tile
+   bool propagateBitset(std::size_t start);
+   Progress resolveBitset(std::size_t limit);
+
+   // support engine: ban every tile in banStack which is still possible
+   bool propagateSupport();
+   Progress resolveSupport(std::size_t limit);
+
+   // support engine: set up support counts and ban unsupported tiles in the starting wave
+   bool resetSupport(const Tiles& start);
+
+   // support engine: remove tile from a cell and take its support away from the neighbours.
+   // Leaves the cell as is and returns false if it is its last possibility
+   bool ban(std::size_t cell, std::size_t tile);
+
+   // bitset engine: remove tiles from a cell, leaving newCount possibilities
+   void remove(std::size_t cell, const Tiles& removed, std::size_t newCount);
+
+   // remove a single tile from an uncollapsed cell and propagate
+   bool exclude(std::size_t cell, std::size_t tile);
+
+   // remove a single tile from an uncollapsed cell and queue its propagation, false on contradiction
+   bool beginExclude(std::size_t cell, std::size_t tile);
+
+   // undo decisions until one whose tile can be excluded without contradiction is found
+   bool backtrack();
+
+   // bring the wave back to the state just before decision
+   void undo(const Decision& decision);
+
+   // removals only need to be recorded once there is a decision to undo
+   bool recording() const { return !decisions.empty(); }
+
+   // remove the weights of removed tiles from the entropy sums of a cell
+   void removeWeights(std::size_t cell, const Tiles& removed);
+
+   // move a tile in entropyList/entropyHeap after its possibilities changed
+   void updateEntropy(std::size_t cell, std::size_t newCount);
+
+   // weighted Shannon entropy of a cell plus its noise
+   double entropyOf(std::size_t cell) const;
+
+   // number of uncollapsed tiles
+   std::size_t remaining() const { return heuristic == Heuristic::entropy ? entropyHeap.size() : entropyList.size(); }
+};
+
+// create a solver for a tileset with the smallest sets of tiles that fit it
+std::unique_ptr<Solver> makeSolver(std::shared_ptr<const TileRules> rules, int width=gridWidth, int height=gridHeight, Propagation propagation=Propagation::bitset,
+                                   Heuristic heuristic=Heuristic::count, std::size_t backtrackLimit=maxBacktracks){
+
+   std::size_t n = rules->uniqueTiles;
+   if (n <= Domain<1>::capacity()){ return std::make_unique<DomainSolver<1>>(std::move(rules), width, height, propagation, heuristic, backtrackLimit); }
+   if (n <= Domain<2>::capacity()){ return std::make_unique<DomainSolver<2>>(std::move(rules), width, height, propagation, heuristic, backtrackLimit); }
+   if (n <= Domain<4>::capacity()){ return std::make_unique<DomainSolver<4>>(std::move(rules), width, height, propagation, heuristic, backtrackLimit); }
+
+   return std::make_unique<DomainSolver<0>>(std::move(rules), width, height, propagation, heuristic, backtrackLimit);
+}
+
+// collapse until the grid is complete (true) or a contradiction is found (false)
+bool Solver::solve(){
+
+   while (!collapsed){
+      if (!getNextCollapse()){ return false; }
+   }
+
+   return true;
+}
+
+void Solver::seed(std::uint64_t value){
+   random.seed(value);
+   reset();
+}
+
+// create wave, fill entropies
+template<std::size_t Words>
+DomainSolver<Words>::DomainSolver(std::shared_ptr<const TileRules> rules, int width, int height, Propagation propagation, Heuristic heuristic, std::size_t backtrackLimit):
+   Solver(std::move(rules), width, height, propagation, heuristic, backtrackLimit), stride(static_cast<std::size_t>(width)+2){
+
+   std::ptrdiff_t row = static_cast<std::ptrdiff_t>(stride);
+   stencil = {1, row, -1, -row};
+
+   // sentinel border is never written after construction
+   wave.assign(stride*(static_cast<std::size_t>(height)+2), Tiles(uniqueTiles));
+   counts.assign(wave.size(), 0);
+   toResolve.reset(wave.size());
+   possible = Tiles(uniqueTiles);
+   removed = Tiles(uniqueTiles);
+
+   // copy compat into sets of this width
+   for (std::size_t i=0; i<4; i++){
+      allowed[i].assign(uniqueTiles, Tiles(uniqueTiles));
+      allowedRows[i].clear();
+      for (std::size_t j=0; j<uniqueTiles; j++){
+         this->rules->compat[i][j].forEach([&](std::size_t tile){ allowed[i][j].set(tile); });
+         if constexpr (Words==0){ allowedRows[i].insert(allowedRows[i].end(), allowed[i][j].words.begin(), allowed[i][j].words.end()); }
+      }
+   }
+
+   reset();
+}
+
+// place all tiles at maximum entropy
+template<std::size_t Words>
+void DomainSolver<Words>::resetEntropy(){
+
+   if (heuristic == Heuristic::count){
+
+      entropyList.reset(wave.size(), uniqueTiles);
+
+      // fill entropyList
+      for (int y=0; y<height; y++){
+         for (int x=0; x<width; x++){
+            entropyList.insert(cell(x,y), counts[cell(x,y)]);
+         }
+      }
+
+      return;
+   }
+
+   // snapshot weights, the menus may change weights during a run
+   tileWeights.resize(uniqueTiles);
+   tileWeightLogWeights.resize(uniqueTiles);
+   for (std::size_t i=0; i<uniqueTiles; i++){
+      tileWeights[i] = weights[i];
+      tileWeightLogWeights[i] = weights[i] > 0 ? tileWeights[i]*std::log(tileWeights[i]) : 0.0;
+   }
+
+   // all tiles start with the same possibilities
+   double startWeights{0.0}, startWeightLogWeights{0.0};
+   wave[cell(0,0)].forEach([&](std::size_t i){
+      startWeights += tileWeights[i];
+      startWeightLogWeights += tileWeightLogWeights[i];
+   });
+
+   sumWeights.assign(wave.size(), startWeights);
+   sumWeightLogWeights.assign(wave.size(), startWeightLogWeights);
+   noise.resize(wave.size());
+
+   // noise is far below the smallest entropy difference between tiles
+   entropyHeap.reset(wave.size());
+   for (int y=0; y<height; y++){
+      for (int x=0; x<width; x++){
+         noise[cell(x,y)] = random.uniform()*1e-6;
+         entropyHeap.insert(cell(x,y), entropyOf(cell(x,y)));
+      }
+   }
+}
+
+template<std::size_t Words>
+void DomainSolver<Words>::reset(){
+
+   WFC_ZONE("Solver::reset");
+
+   // the previous solve ends here
+   WFC_END_SOLVE();
+   WFC_COUNT(resets, 1);
+   totalResets++;
+
+   // every tile starts with all enabled tiles
+   Tiles start(uniqueTiles);
+   enabled.forEach([&](std::size_t i){ start.set(i); });
+   std::uint16_t startCount = static_cast<std::uint16_t>(start.count());
+
+   // reset wave in place, rows of interior cells only
+   for (int y=0; y<height; y++){
+      std::fill_n(wave.begin() + static_cast<std::ptrdiff_t>(cell(0,y)), width, start);
+      std::fill_n(counts.begin() + static_cast<std::ptrdiff_t>(cell(0,y)), width, startCount);
+   }
+
+   // reset Entropy
+   resetEntropy();
+
+   // reset list of updates
+   updates.resize(size());
+   fillingIndex = 0;
+   rewindIndex = std::numeric_limits<std::size_t>::max();
+
+   // set state to uncollapsed
+   collapsed = false;
+   contradiction = false;
+
+   // forget previous decisions (keeps capacity)
+   trail.clear();
+   decisions.clear();
+   backtracks = 0;
+
+   // remove tiles which can't be next to any starting tile (e.g. their only connections are disabled)
+   if (propagation == Propagation::support){
+      contradiction = !resetSupport(start);
+      if (contradiction){
+         WFC_COUNT(contradictions, 1);
+         totalContradictions++;
+      }
+      return;
+   }
+
+   bool supported{true};
+   for (std::size_t i=0; i<4; i++){
+      allowedBy(start, i, possible);
+      supported = supported && (start & ~possible).none();
+   }
+
+   // only propagate when the starting wave is not already consistent
+   for (int y=0; y<height && !supported && !contradiction; y++){
+      for (int x=0; x<width && !contradiction; x++){
+         contradiction = !propagateBitset(cell(x,y));
+      }
+   }
+   if (contradiction){
+      WFC_COUNT(contradictions, 1);
+      totalContradictions++;
+   }
+}
+
+//------------------------------
+// collapse a tile
+//------------------------------
+template<std::size_t Words>
+bool DomainSolver<Words>::getNextCollapse(){
+
+   WFC_ZONE("Solver::getNextCollapse");
+
+   // a previous propagation failed, only a reset can recover
+   if (contradiction){ return false; }
+
+   auto [current, tile] = choose();
+
+   // collapse to new tile and orientation
+   return collapse(cellPos(current), tile);
+}
+
+template<std::size_t Words>
+SolveSteps DomainSolver<Words>::steps(std::size_t slice){
+
+   while (!collapsed && !contradiction){
+
+      auto [current, tile] = choose();
+
+      // collapse, then propagate a slice at a time
+      Progress progress{Progress::done};
+      if (assign(current, tile)){
+         if (propagation == Propagation::bitset){
+            toResolve.start();
+            toResolve.push(current);
+         }
+         while ((progress = resolve(slice)) == Progress::paused){ co_yield SolveStep::propagating; }
+      }
+
+      // on contradiction try other tiles for earlier decisions, as backtrack() does
+      if (progress == Progress::failed){
+         WFC_COUNT(contradictions, 1);
+         totalContradictions++;
+
+         while (progress == Progress::failed && !decisions.empty() && backtracks < backtrackLimit){
+
+            Decision decision = decisions.back();
+            decisions.pop_back();
+            backtracks++;
+            WFC_COUNT(backtracks, 1);
+
+            undo(decision);
+
+            if (!beginExclude(decision.cell, decision.tile)){ continue; }
+            while ((progress = resolve(slice)) == Progress::paused){ co_yield SolveStep::propagating; }
+         }
+
+         contradiction = progress == Progress::failed;
+      }
+
+      co_yield SolveStep::collapse;
+   }
+}
+
+template<std::size_t Words>
+std::pair<std::size_t,std::size_t> DomainSolver<Words>::choose(){
+
+   // choose randomly between the tiles with lowest entropy
+   std::size_t current = heuristic == Heuristic::entropy ? entropyHeap.top() : entropyList.sample(random);
+
+   // only one possibility, no need for random choice
+   if (counts[current]==1){ return {current, wave[current].first()}; }
+
+   return {current, sampleTile(current)};
+}
+
+// walk the running sum of integer weights over the set tiles, so nothing is allocated.
+// (alias tables would need rebuilding for every cell, whose possibilities keep changing)
+template<std::size_t Words>
+std::size_t DomainSolver<Words>::sampleTile(std::size_t cell){
+
+   const Tiles& tiles = wave[cell];
+   auto weight = [this](std::size_t tile){ return static_cast<std::uint64_t>(weights[tile] > 0 ? weights[tile] : 0); };
+
+   std::uint64_t total{0};
+   tiles.forEach([&](std::size_t tile){ total += weight(tile); });
+
+   // all tiles disabled, choose uniformly
+   if (total == 0){
+      std::uint64_t n = random.below(counts[cell]);
+      return tiles.find([&](std::size_t){ return n-- == 0; });
+   }
+
+   std::uint64_t r = random.below(total);
+   return tiles.find([&](std::size_t tile){
+      if (r < weight(tile)){ return true; }
+      r -= weight(tile);
+      return false;
+   });
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::collapse(const Point& pos, std::size_t tile){
+
+   // tile was already resolved by earlier propagations
+   if (!assign(cell(pos), tile)){ return true; }
+
+   // propagate collapse, on contradiction try other tiles for earlier decisions
+   if (propagate(pos)){ return true; }
+   WFC_COUNT(contradictions, 1);
+   totalContradictions++;
+
+   contradiction = !backtrack();
+   return !contradiction;
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::assign(std::size_t current, std::size_t tile){
+
+   std::size_t count = counts[current];
+
+   // a choice between several tiles can be undone
+   if (count > 1 && backtrackLimit > 0){ decisions.push_back({current, tile, trail.size(), fillingIndex}); }
+
+   // add update to update list
+   updates[fillingIndex++] = {cellPos(current), rules->getTile[tile]};
+   WFC_COUNT(collapses, 1);
+   totalCollapses++;
+
+   // remove every other tile while the cell is still in entropyList, so undoing it only needs to re-insert it
+   if (count > 1){
+      removed = wave[current];
+      removed.reset(tile);
+      if (propagation == Propagation::support){ removed.forEach([&](std::size_t i){ ban(current,i); }); }
+      else { remove(current, removed, 1); }
+   }
+
+   // remove from entropyList (only keep uncollapsed tiles)
+   if (heuristic == Heuristic::entropy){ entropyHeap.erase(current); }
+   else { entropyList.erase(current); }
+
+   // check if wavefunction is fully collapsed
+   if (remaining()==0){ collapsed = true; }
+
+   return count > 1;
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::constrain(const Point& pos, const TileSet& tiles){
+
+   if (contradiction){ return false; }
+
+   std::size_t current = cell(pos);
+
+   // tiles of the cell which are not in tiles
+   removed = wave[current];
+   tiles.forEach([&](std::size_t tile){ removed.reset(tile); });
+
+   std::size_t oldCount = counts[current];
+   std::size_t newCount = oldCount - removed.count();
+
+   if (newCount == oldCount){ return true; }
+
+   if (newCount == 0){
+      WFC_COUNT(contradictions, 1);
+      totalContradictions++;
+      contradiction = true;
+      return false;
+   }
+
+   if (propagation == Propagation::support){
+      removed.forEach([&](std::size_t tile){ ban(current,tile); });
+      contradiction = !propagateSupport();
+   }
+   else {
+      remove(current, removed, newCount);
+      contradiction = !propagateBitset(current);
+   }
+
+   if (contradiction){
+      WFC_COUNT(contradictions, 1);
+      totalContradictions++;
+   }
+   return !contradiction;
+}
+
+//------------------------------
+// propagate collapse
+//------------------------------
+template<std::size_t Words>
+bool DomainSolver<Words>::propagate(const Point& currentPos){
+   return propagation == Propagation::support ? propagateSupport() : propagateBitset(cell(currentPos));
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::propagateBitset(std::size_t start){
+
+   // queue of tiles to resolve (need FIFO, want to resolve newly added tiles last)
+   toResolve.start();
+   toResolve.push(start);
+
+   return resolveBitset(std::numeric_limits<std::size_t>::max()) == Progress::done;
+}
+
+template<std::size_t Words>
+Progress DomainSolver<Words>::resolveBitset(std::size_t limit){
+
+   WFC_ZONE("Solver::propagateBitset");
+   WFC_COUNT(propagations, 1);
+
+   // Breadth-first seach. Resolve nearest neighbours, then next nearest etc.
+   // only tiles whose possibilities changed are added, so a tile can be resolved several times
+   for (std::size_t visited=0; !toResolve.empty(); visited++){
+
+      // the rest stays queued for the next call
+      if (visited == limit){ return Progress::paused; }
+
+      // get the top of the queue
+      std::size_t resolving = toResolve.pop();
+      WFC_COUNT(cellsVisited, 1);
+      totalPropagationSteps++;
+
+      const Tiles& resolvingTiles = wave[resolving];
+
+      // propagate possibilities for neighbours
+      for (std::size_t i=0; i<4; i++){
+
+         // get neighbour, sentinels (outside of the grid) have no possibilities
+         std::size_t near = resolving + static_cast<std::size_t>(stencil[i]);
+         std::size_t oldCount = counts[near];
+         if (oldCount == 0){ continue; }
+
+         // take all previous possible states in neighbour and remove those not allowed by any tile resolving can be
+         allowedBy(resolvingTiles, i, possible);
+         removed = wave[near];
+         removed.andNot(possible);
+
+         // count possibilities
+         std::size_t newCount = oldCount - removed.count();
+
+         // nothing changed, nothing to propagate
+         if (newCount == oldCount){ continue; }
+
+         // if there is no possible tile to collapse to, let the caller decide how to recover
+         if (newCount == 0){ return Progress::failed; }
+
+         remove(near, removed, newCount);
+
+         // add neighbour to resolving queue, if not added already
+         toResolve.push(near);
+         WFC_PEAK(queuePeak, toResolve.count);
+      }
+   }
+
+   return Progress::done;
+}
+
+// find all possibilites from union (bitwise |=) of the connections of each tile
+template<std::size_t Words>
+void DomainSolver<Words>::allowedBy(const Tiles& tiles, std::size_t d, Tiles& possible) const {
+
+   // the compiler already unrolls fixed widths into register ops,
+   // sets sized at runtime go through the vectorized kernel
+   if constexpr (Words>0){
+      possible = Tiles(uniqueTiles);
+      tiles.forEach([&](std::size_t j){ possible |= allowed[d][j]; });
+   }
+   else { unionKernel(allowedRows[d].data(), possible.words.size(), tiles.words.data(), possible.words.data()); }
+}
+
+template<std::size_t Words>
+void DomainSolver<Words>::remove(std::size_t cell, const Tiles& removed, std::size_t newCount){
+
+   if (heuristic == Heuristic::entropy){ removeWeights(cell, removed); }
+   if (recording()){ trail.push_back({cell,removed}); }
+   WFC_COUNT(bitsRemoved, counts[cell] - newCount);
+
+   wave[cell].andNot(removed);
+   counts[cell] = static_cast<std::uint16_t>(newCount);
+   updateEntropy(cell, newCount);
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::resetSupport(const Tiles& start){
+
+   banStack.clear();
+
+   // count supports of every tile in the starting wave. Tile j in direction i allows allowed[i][j],
+   // so tile t is supported from direction d by the tiles j with t in allowed[opposite d][j]
+   std::array<std::vector<std::uint16_t>,4> startSupport;
+   for (std::size_t d=0; d<4; d++){
+      startSupport[d].assign(uniqueTiles, 0);
+      start.forEach([&](std::size_t j){
+         allowed[(d+2)%4][j].forEach([&](std::size_t t){ startSupport[d][t]++; });
+      });
+   }
+
+   // counts are stored for the whole wave (including sentinels) to index them like the wave
+   support.resize(wave.size()*4*uniqueTiles);
+   for (int y=0; y<height; y++){
+      for (int x=0; x<width; x++){
+         for (std::size_t d=0; d<4; d++){
+            std::copy(startSupport[d].begin(), startSupport[d].end(), support.begin() + static_cast<std::ptrdiff_t>((cell(x,y)*4+d)*uniqueTiles));
+         }
+      }
+   }
+
+   // ban tiles without support from a neighbour (edges have no neighbour to ask)
+   for (int y=0; y<height; y++){
+      for (int x=0; x<width; x++){
+         std::size_t current = cell(x,y);
+         for (std::size_t d=0; d<4; d++){
+            if (counts[current + static_cast<std::size_t>(stencil[d])] == 0){ continue; }
+
+            for (std::size_t t=0; t<uniqueTiles; t++){
+               if (startSupport[d][t]==0 && wave[current][t]){ banStack.push_back({current,t}); }
+            }
+         }
+      }
+   }
+
+   return propagateSupport();
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::ban(std::size_t cell, std::size_t tile){
+
+   // if there is no possible tile to collapse to, let the caller decide how to recover
+   if (counts[cell] == 1){ return false; }
+
+   if (recording()){ trail.push_back({cell,single(tile)}); }
+
+   wave[cell].reset(tile);
+   counts[cell]--;
+   WFC_COUNT(bitsRemoved, 1);
+
+   if (heuristic == Heuristic::entropy){
+      sumWeights[cell] -= tileWeights[tile];
+      sumWeightLogWeights[cell] -= tileWeightLogWeights[tile];
+   }
+
+   updateEntropy(cell, counts[cell]);
+
+   // a banned tile no longer supports its connections in any neighbour
+   for (std::size_t d=0; d<4; d++){
+
+      // sentinels (outside of the grid) have no possibilities
+      std::size_t near = cell + static_cast<std::size_t>(stencil[d]);
+      if (counts[near] == 0){ continue; }
+
+      const Tiles& nearTiles = wave[near];
+
+      // neighbour's supports from the direction pointing back at us
+      std::uint16_t* nearSupport = &support[(near*4 + (d+2)%4)*uniqueTiles];
+
+      // ban when the last supporting tile is gone
+      allowed[d][tile].forEach([&](std::size_t t){
+         if (--nearSupport[t]==0 && nearTiles[t]){ banStack.push_back({near,t}); }
+      });
+   }
+
+   return true;
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::propagateSupport(){
+   return resolveSupport(std::numeric_limits<std::size_t>::max()) == Progress::done;
+}
+
+template<std::size_t Words>
+Progress DomainSolver<Words>::resolveSupport(std::size_t limit){
+
+   WFC_ZONE("Solver::propagateSupport");
+   WFC_COUNT(propagations, 1);
+
+   for (std::size_t visited=0; !banStack.empty(); visited++){
+
+      // the rest stays stacked for the next call
+      if (visited == limit){ return Progress::paused; }
+
+      WFC_PEAK(queuePeak, banStack.size());
+      auto [current, tile] = banStack.back();
+      banStack.pop_back();
+      WFC_COUNT(cellsVisited, 1);
+      totalPropagationSteps++;
+
+      // already banned through another neighbour
+      if (!wave[current][tile]){ continue; }
+
+      if (!ban(current,tile)){
+         banStack.clear();
+         return Progress::failed;
+      }
+   }
+
+   return Progress::done;
+}
+
+template<std::size_t Words>
+Progress DomainSolver<Words>::resolve(std::size_t limit){
+   return propagation == Propagation::support ? resolveSupport(limit) : resolveBitset(limit);
+}
+
+//------------------------------
+// backtracking
+//------------------------------
+template<std::size_t Words>
+bool DomainSolver<Words>::exclude(std::size_t cell, std::size_t tile){
+   return beginExclude(cell, tile) && resolve(std::numeric_limits<std::size_t>::max()) == Progress::done;
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::beginExclude(std::size_t cell, std::size_t tile){
+
+   if (propagation == Propagation::support){ return ban(cell,tile); }
+
+   remove(cell, single(tile), counts[cell]-1u);
+   toResolve.start();
+   toResolve.push(cell);
+   return true;
+}
+
+template<std::size_t Words>
+bool DomainSolver<Words>::backtrack(){
+
+   WFC_ZONE("Solver::backtrack");
+
+   while (!decisions.empty() && backtracks < backtrackLimit){
+
+      Decision decision = decisions.back();
+      decisions.pop_back();
+      backtracks++;
+      WFC_COUNT(backtracks, 1);
+
+      undo(decision);
+
+      // the cell had other possibilities, the excluded tile is recorded for the previous decision
+      if (exclude(decision.cell, decision.tile)){ return true; }
+   }
+
+   return false;
+}
+
+template<std::size_t Words>
+void DomainSolver<Words>::undo(const Decision& decision){
+
+   banStack.clear();
+
+   // cells collapsed since the decision (including its own) become uncollapsed again,
+   // with their current counts which the trail then brings back up
+   for (std::size_t i=decision.fillingIndex; i<fillingIndex; i++){
+      std::size_t current = cell(updates[i].first);
+      if (heuristic == Heuristic::entropy){ entropyHeap.insert(current, entropyOf(current)); }
+      else { entropyList.insert(current, counts[current]); }
+   }
+
+   rewindIndex = std::min(rewindIndex, decision.fillingIndex);
+   fillingIndex = decision.fillingIndex;
+   collapsed = false;
+
+   // put back every removed tile, latest first
+   while (trail.size() > decision.trailSize){
+
+      auto [current, removed] = std::move(trail.back());
+      trail.pop_back();
+
+      wave[current] |= removed;
+      counts[current] = static_cast<std::uint16_t>(counts[current] + removed.count());
+
+      removed.forEach([&](std::size_t tile){
+
+         if (heuristic == Heuristic::entropy){
+            sumWeights[current] += tileWeights[tile];
+            sumWeightLogWeights[current] += tileWeightLogWeights[tile];
+         }
+
+         if (propagation != Propagation::support){ return; }
+
+         // give its support back to the neighbours
+         for (std::size_t d=0; d<4; d++){
+
+            std::size_t near = current + static_cast<std::size_t>(stencil[d]);
+            if (counts[near] == 0){ continue; }
+
+            std::uint16_t* nearSupport = &support[(near*4 + (d+2)%4)*uniqueTiles];
+            allowed[d][tile].forEach([&](std::size_t t){ nearSupport[t]++; });
+         }
+      });
+
+      updateEntropy(current, counts[current]);
+   }
+}
+
+// move a tile between entries of entropyList after its count changed
+template<std::size_t Words>
+void DomainSolver<Words>::updateEntropy(std::size_t cell, std::size_t newCount){
+   if (heuristic == Heuristic::entropy){ entropyHeap.update(cell, entropyOf(cell)); }
+   else { entropyList.update(cell, newCount); }
+}
+
+template<std::size_t Words>
+void DomainSolver<Words>::removeWeights(std::size_t cell, const Tiles& removed){
+   removed.forEach([&](std::size_t i){
+      sumWeights[cell] -= tileWeights[i];
+      sumWeightLogWeights[cell] -= tileWeightLogWeights[i];
+   });
+}
+
+// H = log(sum w) - sum(w log w)/sum w
+template<std::size_t Words>
+double DomainSolver<Words>::entropyOf(std::size_t cell) const {
+
+   // a single possibility has no entropy (avoids rounding errors of the running sums)
+   if (counts[cell] <= 1 || sumWeights[cell] <= 0.0){ return noise[cell]; }
+
+   return std::log(sumWeights[cell]) - sumWeightLogWeights[cell]/sumWeights[cell] + noise[cell];
+}
+
+// histogram of uncollapsed cells by number of remaining possibilities (cells[n] holds those with n)
+template<std::size_t Words>
+void DomainSolver<Words>::pendingCells(std::vector<std::size_t>& cells) const {
+
+   cells.assign(uniqueTiles+1, 0);
+
+   if (heuristic == Heuristic::entropy){
+      for (std::size_t cell : entropyHeap.heap){ cells[counts[cell]]++; }
+      return;
+   }
+
+   // the list already groups them
+   for (std::size_t n=0; n<cells.size() && n<entropyList.buckets.size(); n++){ cells[n] = entropyList.buckets[n].size(); }
+}
+
+template<std::size_t Words>
+tileState DomainSolver<Words>::tileAt(int x, int y) const {
+   return rules->getTile[wave[cell(x,y)].first()];
+}
+
+template<std::size_t Words>
+std::size_t DomainSolver<Words>::memory() const {
+
+   auto bytes = [](const auto& vector){ return vector.capacity()*sizeof(vector[0]); };
+
+   std::size_t total = bytes(wave) + bytes(counts) + bytes(allowedRows[0])*4 + bytes(updates) + bytes(support) + bytes(banStack)
+                     + bytes(trail) + bytes(decisions) + bytes(sumWeights) + bytes(sumWeightLogWeights) + bytes(noise)
+                     + bytes(entropyList.bucketOf) + bytes(entropyList.indexOf)
+                     + bytes(entropyHeap.heap) + bytes(entropyHeap.keys) + bytes(entropyHeap.indexOf)
+                     + bytes(toResolve.ring) + bytes(toResolve.stamps);
+
+   for (const auto& bucket : entropyList.buckets){ total += bytes(bucket); }
+
+   // sets sized at runtime keep their words on the heap
+   if constexpr (Words==0){
+      for (const Tiles& tiles : wave){ total += bytes(tiles.words); }
+      for (const auto& removed : trail){ total += bytes(removed.second.words); }
+   }
+
+   return total;
+}
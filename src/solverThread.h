@@ -0,0 +1,309 @@
+#pragma once
+
+#include<atomic>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<limits>
+#include<thread>
+#include<utility>
+#include<vector>
+
+#include"domain.h"
+#include"point.h"
+#include"profile.h"
+#include"ring.h"
+#include"solver.h"
+#include"steps.h"
+
+// what the solver hands to the viewer
+struct SolverUpdate{
+   enum class Kind{ tile, rewind, solved, stuck };
+
+   Kind kind{Kind::tile};
+
+   // reset the map was solved from, updates of earlier maps are dropped by the viewer
+   std::uint32_t generation{0};
+
+   // position in the list of updates of a tile, or where a backtrack went back to
+   std::size_t index{0};
+
+   Point pos{};
+   tileState state{};
+};
+
+// what the viewer asks of the solver
+struct SolverCommand{
+   enum class Kind{ reset, weights, pause, pending, stop };
+
+   Kind kind{Kind::reset};
+
+   // reset: the generation of the new map
+   std::uint32_t generation{0};
+
+   // reset and weights
+   std::vector<int> weights;
+   TileSet enabled;
+
+   // pause
+   bool paused{false};
+};
+
+// Runs a solver on a worker thread, so solving is not tied to the frame rate and a long propagation
+// doesn't stall a frame. The viewer never touches the solver while it runs: new tiles, backtracks and
+// the end of a map come back through one lock-free ring (SpscRing), and resets, weights and pausing go
+// to the worker through another. Both step the solver as a coroutine (Solver::steps), a slice of
+// propagation at a time, so commands are seen partway through a long propagation. Without threads
+// (emscripten without pthreads) step() runs the same work from the frame until its time budget is spent.
+struct SolverThread{
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+   static constexpr bool threaded{false};
+#else
+   static constexpr bool threaded{true};
+#endif
+
+   // solver to viewer, read by the viewer every frame
+   SpscRing<SolverUpdate> updates{1 << 16};
+
+   // cells propagated between two checks of the commands or the clock
+   static constexpr std::size_t slice{1024};
+
+   // uncollapsed cells by number of possibilities, answering SolverCommand::Kind::pending
+   SpscRing<std::vector<std::size_t>> pending{4};
+
+   // the solver's totals, copied after every step
+   std::atomic<std::uint64_t> collapses{0};
+   std::atomic<std::uint64_t> propagationSteps{0};
+   std::atomic<std::uint64_t> contradictions{0};
+   std::atomic<std::uint64_t> resets{0};
+
+   SolverThread() = default;
+   SolverThread(const SolverThread&) = delete;
+   SolverThread& operator=(const SolverThread&) = delete;
+
+   ~SolverThread(){ stop(); }
+
+   // hand solver to the worker, continuing the map of generation from its first update
+   void start(Solver& solver, std::uint32_t generation);
+
+   // stop the worker after its current step, the solver is the caller's again
+   void stop();
+
+   // between start and stop
+   bool running() const { return solver != nullptr; }
+
+   // queue a command, applied before the next step
+   void send(SolverCommand command);
+
+   // without threads: apply the commands and solve on the calling thread for about seconds,
+   // or until maxCollapses collapses are done (0: no limit)
+   void step(double seconds, int maxCollapses=0);
+
+private:
+
+   Solver* solver{nullptr};
+   std::thread worker;
+
+   // solve in progress, suspended between slices
+   SolveSteps task;
+
+   // viewer to solver
+   SpscRing<SolverCommand> commands{64};
+
+   // bumped with every command, the worker sleeps on it while it has nothing to do
+   std::atomic<std::uint32_t> sent{0};
+
+   // the worker's state
+   std::uint32_t generation{0};
+   std::size_t published{0};
+   bool paused{false};
+   bool finished{false};
+   SolverUpdate::Kind ending{SolverUpdate::Kind::solved};
+   bool endPublished{false};
+
+   // solve until told to stop
+   void run();
+
+   // apply queued commands, false on stop
+   bool apply();
+
+   // one slice of the solve, true if it finished a collapse
+   bool advance();
+
+   // hand the updates made since last time to the viewer, false if the ring filled up first
+   bool publish();
+};
+
+void SolverThread::start(Solver& solver, std::uint32_t generation){
+
+   stop();
+
+   this->solver = &solver;
+   this->generation = generation;
+   task = SolveSteps();
+   published = 0;
+   paused = false;
+   finished = false;
+   endPublished = false;
+
+   if constexpr (threaded){ worker = std::thread([this]{ run(); }); }
+}
+
+void SolverThread::stop(){
+
+   if (!solver){ return; }
+
+   if constexpr (threaded){
+      SolverCommand command;
+      command.kind = SolverCommand::Kind::stop;
+      send(std::move(command));
+      worker.join();
+   }
+
+   // commands the worker won't see anymore, and the solve it was in
+   SolverCommand command;
+   while (commands.pop(command)){}
+   task = SolveSteps();
+
+   solver = nullptr;
+}
+
+void SolverThread::send(SolverCommand command){
+
+   // commands are few, the ring is only full while the worker is busy with one step
+   while (!commands.push(command)){
+      if constexpr (threaded){ std::this_thread::yield(); }
+      else { apply(); }
+   }
+
+   sent.fetch_add(1, std::memory_order_release);
+   sent.notify_one();
+}
+
+void SolverThread::step(double seconds, int maxCollapses){
+
+   if (!solver || !apply()){ return; }
+
+   using clock = std::chrono::steady_clock;
+   clock::time_point end = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+
+   int done{0};
+   while (!paused && !finished && (maxCollapses == 0 || done < maxCollapses) && clock::now() < end){
+      if (!publish()){ return; }
+      if (advance()){ done++; }
+   }
+   publish();
+}
+
+void SolverThread::run(){
+
+   while (true){
+
+      std::uint32_t seen = sent.load(std::memory_order_acquire);
+      if (!apply()){ return; }
+
+      // a map that is finished, or a full ring the viewer hasn't caught up with
+      bool caughtUp = publish();
+      if (paused || (finished && caughtUp)){
+         sent.wait(seen, std::memory_order_acquire);
+         continue;
+      }
+      if (!caughtUp){
+         std::this_thread::yield();
+         continue;
+      }
+
+      advance();
+   }
+}
+
+bool SolverThread::apply(){
+
+   SolverCommand command;
+   while (commands.pop(command)){
+
+      switch (command.kind){
+
+         case SolverCommand::Kind::reset:
+            task = SolveSteps();
+            solver->weights = std::move(command.weights);
+            solver->enabled = std::move(command.enabled);
+            solver->reset();
+
+            // what is left in the ring belongs to the previous map
+            generation = command.generation;
+            published = 0;
+            finished = false;
+            endPublished = false;
+            break;
+
+         case SolverCommand::Kind::weights:
+            solver->weights = std::move(command.weights);
+            break;
+
+         case SolverCommand::Kind::pause:
+            paused = command.paused;
+            break;
+
+         case SolverCommand::Kind::pending: {
+            std::vector<std::size_t> cells;
+            solver->pendingCells(cells);
+            pending.push(cells);
+            break;
+         }
+
+         case SolverCommand::Kind::stop:
+            return false;
+      }
+   }
+
+   collapses.store(solver->totalCollapses, std::memory_order_relaxed);
+   propagationSteps.store(solver->totalPropagationSteps, std::memory_order_relaxed);
+   contradictions.store(solver->totalContradictions, std::memory_order_relaxed);
+   resets.store(solver->totalResets, std::memory_order_relaxed);
+
+   return true;
+}
+
+bool SolverThread::advance(){
+
+   if (!task){ task = solver->steps(slice); }
+
+   bool collapse = task.next() && task.step() == SolveStep::collapse;
+
+   // no possible tile left even after backtracking (the viewer starts a new map), or the grid is done
+   if (!task || (collapse && (solver->contradiction || solver->collapsed))){
+      finished = true;
+      ending = solver->contradiction ? SolverUpdate::Kind::stuck : SolverUpdate::Kind::solved;
+      task = SolveSteps();
+   }
+
+   collapses.store(solver->totalCollapses, std::memory_order_relaxed);
+   propagationSteps.store(solver->totalPropagationSteps, std::memory_order_relaxed);
+   contradictions.store(solver->totalContradictions, std::memory_order_relaxed);
+
+   return collapse;
+}
+
+bool SolverThread::publish(){
+
+   // a backtrack undid updates already handed out
+   if (solver->rewindIndex < published){
+      if (!updates.push({SolverUpdate::Kind::rewind, generation, solver->rewindIndex, {}, {}})){ return false; }
+      published = solver->rewindIndex;
+   }
+   solver->rewindIndex = std::numeric_limits<std::size_t>::max();
+
+   for (; published<solver->fillingIndex; published++){
+      auto& [pos, state] = solver->updates[published];
+      if (!updates.push({SolverUpdate::Kind::tile, generation, published, pos, state})){ return false; }
+   }
+
+   if (finished && !endPublished){
+      if (!updates.push({ending, generation, published, {}, {}})){ return false; }
+      endPublished = true;
+   }
+
+   return true;
+}
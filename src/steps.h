@@ -0,0 +1,77 @@
+#pragma once
+
+#include<coroutine>
+#include<utility>
+
+// where a SolveSteps task stopped
+enum class SolveStep{
+   propagating,  // partway through the propagation of a collapse (or of a backtrack)
+   collapse      // a collapse and its propagation are done
+};
+
+// Solving as a C++20 coroutine (Solver::steps): every next() runs it to its next step and suspends,
+// keeping its place in the propagation for the following call. The caller decides when to stop,
+// e.g. once a frame's time budget is spent. Destroying the task abandons the solve where it was.
+struct SolveSteps{
+
+   struct promise_type{
+
+      SolveStep step{SolveStep::collapse};
+
+      SolveSteps get_return_object(){ return SolveSteps(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+      // nothing runs before the first next()
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      std::suspend_always final_suspend() noexcept { return {}; }
+
+      std::suspend_always yield_value(SolveStep value) noexcept {
+         step = value;
+         return {};
+      }
+
+      void return_void() noexcept {}
+      void unhandled_exception(){ throw; }
+   };
+
+   SolveSteps() = default;
+   explicit SolveSteps(std::coroutine_handle<promise_type> handle): handle(handle){};
+
+   SolveSteps(SolveSteps&& other) noexcept : handle(std::exchange(other.handle, {})){};
+   SolveSteps& operator=(SolveSteps&& other) noexcept;
+
+   SolveSteps(const SolveSteps&) = delete;
+   SolveSteps& operator=(const SolveSteps&) = delete;
+
+   ~SolveSteps(){ if (handle){ handle.destroy(); } }
+
+   // run to the next step, false once the solve has ended (or there is no task)
+   bool next();
+
+   // step the last next() stopped at
+   SolveStep step() const { return handle.promise().step; }
+
+   // a task which has not ended yet
+   explicit operator bool() const { return handle && !handle.done(); }
+
+private:
+
+   std::coroutine_handle<promise_type> handle{};
+};
+
+SolveSteps& SolveSteps::operator=(SolveSteps&& other) noexcept{
+
+   if (this != &other){
+      if (handle){ handle.destroy(); }
+      handle = std::exchange(other.handle, {});
+   }
+
+   return *this;
+}
+
+bool SolveSteps::next(){
+
+   if (!handle || handle.done()){ return false; }
+
+   handle.resume();
+   return !handle.done();
+}
@@ -17,6 +17,10 @@ struct Storage{
    T& getRef(std::string filename);
    T* getPtr(std::string filename);
 
+   // keep something made in memory under a name (not a file path), unloaded with the rest
+   bool contains(const std::string& name) const;
+   T* add(std::string name, T value);
+
    void unloadAll();
 
 private:
@@ -32,6 +36,26 @@ private:
 Storage<Texture2D> textureStore;
 Storage<Font> fontStore;
 
+template <typename T>
+bool Storage<T>::contains(const std::string& name) const{
+   return textureIndex.contains(name);
+}
+
+template <typename T>
+T* Storage<T>::add(std::string name, T value){
+
+   // check if limit reached
+   if (index == textures.size()){
+      std::cerr << "Texture storage limit reached. Cannot add \"" << name << "\".\n";
+      std::exit(EXIT_FAILURE);
+   }
+
+   textures[index] = value;
+   textureIndex[name] = index;
+
+   return &textures[index++];
+}
+
 // Texture Storage
 template<>
 Texture2D& Storage<Texture2D>::getRef(std::string filename){
@@ -0,0 +1,275 @@
+#pragma once
+
+#include<algorithm>
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<map>
+#include<memory>
+#include<mutex>
+#include<optional>
+#include<utility>
+#include<vector>
+
+#include"analyzeTiles.h"
+#include"edges.h"
+#include"globals.h"
+#include"point.h"
+#include"pool.h"
+#include"profile.h"
+#include"random.h"
+#include"solver.h"
+
+// Large map solved in rectangular pieces on a thread pool. A piece is solved once the pieces to its
+// left and above are, with its edges matched to theirs (see EdgeMatcher), so pieces on the same
+// anti-diagonal run in parallel (wavefront order). Seams which still don't connect are then repaired
+// one after the other, re-solving a window around each. Pieces and windows are seeded from (map seed,
+// position), so the map only depends on the seed, never on the number of threads or their timing.
+struct TiledMap{
+
+   // map and piece size in tiles (pieces on the right and bottom edges hold what is left)
+   int width;
+   int height;
+   int pieceWidth;
+   int pieceHeight;
+
+   // collapsed tiles, row by row
+   std::vector<tileState> tiles;
+
+   // tiles across piece seams which still don't connect once repaired (illegalSeams)
+   std::size_t unmatched{0};
+
+   // windows re-solved across seams
+   std::size_t repairs{0};
+
+   // restarts and undone decisions of every piece
+   std::size_t restarts{0};
+   std::size_t backtracks{0};
+
+   // tiles which ran out of possibilities in every piece, also the ones backtracking recovered from
+   std::size_t contradictions{0};
+
+   // false if a piece could not be solved at all
+   bool solved{true};
+
+   TiledMap(int width, int height, int pieceWidth, int pieceHeight):
+      width(width), height(height), pieceWidth(pieceWidth), pieceHeight(pieceHeight),
+      tiles(static_cast<std::size_t>(width)*static_cast<std::size_t>(height)){};
+
+   // number of pieces across and down
+   int columns() const { return (width + pieceWidth - 1)/pieceWidth; }
+   int rows() const { return (height + pieceHeight - 1)/pieceHeight; }
+
+   tileState& at(int x, int y){ return tiles[static_cast<std::size_t>(y)*static_cast<std::size_t>(width) + static_cast<std::size_t>(x)]; }
+   tileState tileAt(int x, int y) const { return tiles[static_cast<std::size_t>(y)*static_cast<std::size_t>(width) + static_cast<std::size_t>(x)]; }
+
+   // neighbouring tiles across the seams between pieces which don't connect
+   std::size_t illegalSeams(const TileRules& rules) const;
+};
+
+std::size_t TiledMap::illegalSeams(const TileRules& rules) const {
+
+   std::size_t illegal{0};
+
+   // first column of every piece against the tile on its left, first row against the tile above
+   for (int y=0; y<height; y++){
+      for (int x=pieceWidth; x<width; x+=pieceWidth){ illegal += !rules.connects(tileAt(x-1,y), 0, tileAt(x,y)); }
+   }
+   for (int y=pieceHeight; y<height; y+=pieceHeight){
+      for (int x=0; x<width; x++){ illegal += !rules.connects(tileAt(x,y-1), 1, tileAt(x,y)); }
+   }
+
+   return illegal;
+}
+
+// Generates tiled maps of one tileset on a pool. Keeps a solver per worker and piece size, so the
+// buffers are reused by every piece and map it generates.
+struct TiledGenerator{
+
+   // rules shared by every solver
+   std::shared_ptr<const TileRules> rules;
+
+   ThreadPool& pool;
+
+   // settings of the solvers
+   Propagation propagation;
+   Heuristic heuristic;
+   std::size_t backtrackLimit;
+
+   // restarts allowed per piece
+   std::size_t maxAttempts{100};
+
+   // side of the window first re-solved around a seam which doesn't connect, doubled up to maxRepairWindow
+   // while the tiles around it leave no solution, and restarts allowed per window
+   int repairWindow{8};
+   int maxRepairWindow{64};
+   std::size_t repairAttempts{10};
+
+   TiledGenerator(std::shared_ptr<const TileRules> rules, ThreadPool& pool, Propagation propagation=Propagation::bitset,
+                  Heuristic heuristic=Heuristic::count, std::size_t backtrackLimit=maxBacktracks);
+
+   // solve map from seed, blocks until done
+   void generate(TiledMap& map, std::uint64_t seed);
+
+private:
+
+   // state of one worker, only touched by its thread
+   struct Context{
+      std::map<std::pair<int,int>, std::unique_ptr<Solver>> solvers;
+      EdgeMatcher matcher;
+   };
+   std::vector<Context> contexts;
+
+   // guards creating solvers (their constructor draws from the global generator) and the map's counters
+   std::mutex mutex;
+
+   // solver of a worker for pieces of a size
+   Solver& solverFor(Context& context, int width, int height);
+
+   // solve piece (i,j) of map on worker, then queue the pieces which were waiting for it
+   void solvePiece(TiledMap& map, std::uint64_t seed, int i, int j, std::size_t worker, std::vector<std::atomic<int>>& waiting);
+
+   // re-solve windows across the seams which don't connect, once every piece is solved
+   void repair(TiledMap& map, std::uint64_t seed);
+};
+
+TiledGenerator::TiledGenerator(std::shared_ptr<const TileRules> rules, ThreadPool& pool, Propagation propagation, Heuristic heuristic, std::size_t backtrackLimit):
+   rules(std::move(rules)), pool(pool), propagation(propagation), heuristic(heuristic), backtrackLimit(backtrackLimit), contexts(pool.size()){};
+
+void TiledGenerator::generate(TiledMap& map, std::uint64_t seed){
+
+   map.unmatched = 0;
+   map.repairs = 0;
+   map.restarts = 0;
+   map.backtracks = 0;
+   map.contradictions = 0;
+   map.solved = true;
+
+   // number of pieces (left, above) each piece still waits for
+   std::vector<std::atomic<int>> waiting(static_cast<std::size_t>(map.columns())*static_cast<std::size_t>(map.rows()));
+   for (int j=0; j<map.rows(); j++){
+      for (int i=0; i<map.columns(); i++){ waiting[static_cast<std::size_t>(j*map.columns() + i)] = (i > 0) + (j > 0); }
+   }
+
+   pool.submit([&](std::size_t worker){ solvePiece(map, seed, 0, 0, worker, waiting); });
+   pool.wait();
+
+   if (map.solved){ repair(map, seed); }
+}
+
+Solver& TiledGenerator::solverFor(Context& context, int width, int height){
+
+   std::unique_ptr<Solver>& solver = context.solvers[{width, height}];
+   if (!solver){
+      std::lock_guard<std::mutex> lock(mutex);
+      solver = makeSolver(rules, width, height, propagation, heuristic, backtrackLimit);
+   }
+   return *solver;
+}
+
+void TiledGenerator::solvePiece(TiledMap& map, std::uint64_t seed, int i, int j, std::size_t worker, std::vector<std::atomic<int>>& waiting){
+
+   WFC_ZONE("TiledGenerator::solvePiece");
+
+   Context& context = contexts[worker];
+
+   int left = i*map.pieceWidth, top = j*map.pieceHeight;
+   int width = std::min(map.pieceWidth, map.width - left), height = std::min(map.pieceHeight, map.height - top);
+   Solver& solver = solverFor(context, width, height);
+
+   // match the last column of the piece on the left and the last row of the piece above
+   EdgeMatcher& matcher = context.matcher;
+   matcher.clear();
+   matcher.maxAttempts = maxAttempts;
+   if (i > 0){
+      for (int y=0; y<height; y++){ matcher.add(*rules, {0,y}, 2, map.at(left-1, top+y)); }
+   }
+   if (j > 0){
+      for (int x=0; x<width; x++){ matcher.add(*rules, {x,0}, 3, map.at(left+x, top-1)); }
+   }
+
+   solver.random.seed(mixSeed(seed, i, j));
+   std::uint64_t contradictions = solver.totalContradictions;
+   std::optional<std::size_t> unmatched = matcher.solve(solver);
+
+   // pieces write to their own part of the map only, the counters are shared
+   if (unmatched){
+      for (int y=0; y<height; y++){
+         for (int x=0; x<width; x++){ map.at(left+x, top+y) = solver.tileAt(x,y); }
+      }
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      map.restarts += matcher.restarts;
+      map.backtracks += matcher.backtracks;
+      map.contradictions += static_cast<std::size_t>(solver.totalContradictions - contradictions);
+      map.solved = map.solved && unmatched.has_value();
+   }
+
+   // the last of a piece's dependencies to finish queues it (atomic decrements also publish our tiles)
+   if (i+1 < map.columns() && --waiting[static_cast<std::size_t>(j*map.columns() + i+1)] == 0){
+      pool.submit([&map, &waiting, this, seed, i, j](std::size_t next){ solvePiece(map, seed, i+1, j, next, waiting); });
+   }
+   if (j+1 < map.rows() && --waiting[static_cast<std::size_t>((j+1)*map.columns() + i)] == 0){
+      pool.submit([&map, &waiting, this, seed, i, j](std::size_t next){ solvePiece(map, seed, i, j+1, next, waiting); });
+   }
+}
+
+void TiledGenerator::repair(TiledMap& map, std::uint64_t seed){
+
+   WFC_ZONE("TiledGenerator::repair");
+
+   // the pool is idle, use the solvers of its first worker
+   Context& context = contexts[0];
+   EdgeMatcher& matcher = context.matcher;
+   matcher.maxAttempts = repairAttempts;
+
+   auto tileAt = [&](long long x, long long y) -> tileState* {
+      if (x<0 || y<0 || x>=map.width || y>=map.height){ return nullptr; }
+      return &map.at(static_cast<int>(x), static_cast<int>(y));
+   };
+
+   // window centered on (x,y), grown while it can't be solved
+   auto around = [&](int x, int y) -> bool {
+
+      for (int size=repairWindow; ; size*=2){
+
+         int width = std::min(size, map.width), height = std::min(size, map.height);
+         int left = std::clamp(x - width/2, 0, map.width - width), top = std::clamp(y - height/2, 0, map.height - height);
+
+         Solver& solver = solverFor(context, width, height);
+         solver.random.seed(mixSeed(mixSeed(seed, x, y), size, size));
+         std::uint64_t contradictions = solver.totalContradictions;
+         bool repaired = matcher.repair(solver, left, top, tileAt);
+
+         map.restarts += matcher.restarts;
+         map.backtracks += matcher.backtracks;
+         map.contradictions += static_cast<std::size_t>(solver.totalContradictions - contradictions);
+
+         if (repaired){
+            map.repairs++;
+            return true;
+         }
+         if (size >= maxRepairWindow || (width == map.width && height == map.height)){ return false; }
+      }
+   };
+
+   // the same seams as illegalSeams, a repair may already have fixed the ones after it. A window can have a
+   // seam still to repair on its border which leaves it no solution, so go over them again while that helps
+   bool progress{true};
+   while (progress && (map.unmatched = map.illegalSeams(*rules)) > 0){
+
+      progress = false;
+      for (int y=0; y<map.height; y++){
+         for (int x=map.pieceWidth; x<map.width; x+=map.pieceWidth){
+            if (!rules->connects(map.tileAt(x-1,y), 0, map.tileAt(x,y)) && around(x,y)){ progress = true; }
+         }
+      }
+      for (int y=map.pieceHeight; y<map.height; y+=map.pieceHeight){
+         for (int x=0; x<map.width; x++){
+            if (!rules->connects(map.tileAt(x,y-1), 1, map.tileAt(x,y)) && around(x,y)){ progress = true; }
+         }
+      }
+   }
+}
@@ -19,11 +19,10 @@ std::string setUpTileset(){
       tilesets.push_back((*std::next(entry.path().begin())));
    }
 
-   std::filesystem::path choice;
+   // directory order is platform dependent, sort for the same list everywhere
+   std::sort(tilesets.begin(), tilesets.end());
 
-   std::sample(tilesets.begin(), tilesets.end(), &choice, 1, gen);
-
-   return choice.string();
+   return tilesets[gen.below(tilesets.size())].string();
 }
 
 // get full path to tilesetFile
@@ -36,6 +35,11 @@ std::string pathToData(){
    return std::string{tilesetBaseDir + tilesetDir + tilesetDataFile}; 
 }
 
+// get full path to the compiled tilesetData
+std::string pathToRules(){
+   return std::string{tilesetBaseDir + tilesetDir + tilesetRulesFile}; 
+}
+
 // print state
 void print(const tileState& state){
    std::cout << "{" << state.x << "," << state.y << "}"; 
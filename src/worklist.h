@@ -0,0 +1,78 @@
+#pragma once
+
+#include<algorithm>
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+// FIFO of cells for breadth-first propagation, holding each cell at most once. The ring buffer and
+// stamps are allocated by reset() and reused by every propagation, which then never allocates.
+// A cell is queued when its stamp equals the current pass, so start() empties the list in O(1)
+// even if the previous pass stopped early (e.g. on a contradiction)
+struct WorkList{
+
+   // queued cells, from head (oldest) to head+count (wrapping)
+   std::vector<std::size_t> ring;
+   std::size_t head{0};
+   std::size_t count{0};
+
+   // pass in which each cell was queued (0: never)
+   std::vector<std::uint32_t> stamps;
+   std::uint32_t pass{0};
+
+   // empty list for cell ids below nCells
+   void reset(std::size_t nCells);
+
+   // start a new propagation with an empty list
+   void start();
+
+   // add cell at the back, unless it is already queued
+   void push(std::size_t cell);
+
+   // remove and return the front cell
+   std::size_t pop();
+
+   bool empty() const { return count==0; }
+};
+
+void WorkList::reset(std::size_t nCells){
+
+   // every cell can be queued at once
+   ring.assign(nCells, 0);
+   stamps.assign(nCells, 0);
+   pass = 0;
+   head = 0;
+   count = 0;
+}
+
+void WorkList::start(){
+
+   head = 0;
+   count = 0;
+
+   // stamps of old passes could match again after the counter wraps
+   if (++pass == 0){
+      std::fill(stamps.begin(), stamps.end(), 0);
+      pass = 1;
+   }
+}
+
+void WorkList::push(std::size_t cell){
+
+   if (stamps[cell] == pass){ return; }
+   stamps[cell] = pass;
+
+   std::size_t tail = head + count++;
+   ring[tail < ring.size() ? tail : tail - ring.size()] = cell;
+}
+
+std::size_t WorkList::pop(){
+
+   std::size_t cell = ring[head];
+   if (++head == ring.size()){ head = 0; }
+   count--;
+
+   // may be queued again later in the same pass
+   stamps[cell] = 0;
+   return cell;
+}
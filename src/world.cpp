@@ -0,0 +1,181 @@
+#include<algorithm>
+#include<array>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<cstdlib>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<optional>
+#include<string>
+#include<string_view>
+#include<utility>
+
+#include"analyzeTiles.h"
+#include"chunks.h"
+#include"compiledTiles.h"
+#include"config.h"
+#include"globals.h"
+#include"random.h"
+#include"solver.h"
+#include"utils.h"
+
+// command line options of the endless world demo
+struct WorldOptions{
+    std::string tileset{"circuit"};
+    int chunkWidth{16};
+    int chunkHeight{16};
+    std::uint64_t seed{0};
+    std::size_t cache{64};
+    std::size_t steps{1000};
+    int view{1};
+    Propagation propagation{Propagation::bitset};
+    std::filesystem::path out{};                                       // no map when empty
+};
+
+void printUsage(){
+    std::cout << "Usage: wfc_world [options]\n"
+              << "  --tileset NAME       tileset directory in tilesets/ (default circuit)\n"
+              << "  --chunk WxH          chunk size in tiles (default 16x16)\n"
+              << "  --seed N             world seed (default 0)\n"
+              << "  --cache N            chunks kept in memory (default 64)\n"
+              << "  --steps N            chunks walked from the origin, in random directions (default 1000)\n"
+              << "  --view R             chunks visible around the walker in each direction (default 1)\n"
+              << "  --propagation TYPE   bitset or support (AC-4) propagation engine (default bitset)\n"
+              << "  --out FILE           write the tiles around the end of the walk to FILE\n";
+}
+
+// parse command line, exits on bad input
+WorldOptions parseOptions(int argc, char* argv[]){
+
+    WorldOptions options;
+
+    for (int i=1; i<argc; i++){
+        std::string_view arg{argv[i]};
+
+        // options which take a value
+        auto value = [&]() -> std::string {
+            if (i+1 >= argc){
+                std::cerr << "Missing value for \"" << arg << "\".\n";
+                std::exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+
+        try {
+            if (arg=="--tileset"){ options.tileset = value(); }
+            else if (arg=="--chunk"){ std::tie(options.chunkWidth, options.chunkHeight) = parseSize(value()); }
+            else if (arg=="--seed"){ options.seed = std::stoull(value()); }
+            else if (arg=="--cache"){ options.cache = std::stoull(value()); }
+            else if (arg=="--steps"){ options.steps = std::stoull(value()); }
+            else if (arg=="--view"){ options.view = std::stoi(value()); }
+            else if (arg=="--propagation"){
+                std::string type = value();
+                if (type=="bitset"){ options.propagation = Propagation::bitset; }
+                else if (type=="support"){ options.propagation = Propagation::support; }
+                else { throw std::invalid_argument("propagation"); }
+            }
+            else if (arg=="--out"){ options.out = value(); }
+            else if (arg=="--help" || arg=="-h"){
+                printUsage();
+                std::exit(EXIT_SUCCESS);
+            }
+            else {
+                std::cerr << "Unknown option \"" << arg << "\".\n";
+                printUsage();
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        catch (const std::logic_error&){
+            std::cerr << "Invalid value for \"" << arg << "\".\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    std::size_t visible = static_cast<std::size_t>(2*options.view+1)*static_cast<std::size_t>(2*options.view+1);
+    if (options.chunkWidth<=0 || options.chunkHeight<=0 || options.view<0 || options.cache<visible){
+        std::cerr << "Chunk size must be positive and the cache must hold every visible chunk.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    return options;
+}
+
+// write the chunks within view of center in bracket notation {a,b}, one row of tiles per line
+void writeView(const std::filesystem::path& path, ChunkWorld& world, const Point& center, int view){
+
+    std::ofstream file(path);
+    if (!file.is_open()){
+        std::cerr << "Could not open \"" << path.string() << "\" for writing.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    long long left = static_cast<long long>(center.x - view)*world.chunkWidth;
+    long long top  = static_cast<long long>(center.y - view)*world.chunkHeight;
+    long long width  = static_cast<long long>(2*view+1)*world.chunkWidth;
+    long long height = static_cast<long long>(2*view+1)*world.chunkHeight;
+
+    for (long long y=top; y<top+height; y++){
+        for (long long x=left; x<left+width; x++){
+            std::optional<tileState> tile = world.tileAt(x,y);
+            if (!tile){
+                std::cerr << "Tile (" << x << "," << y << ") could not be collapsed in " << world.matcher.maxAttempts << " attempts, or connected to its neighbours.\n";
+                std::exit(EXIT_FAILURE);
+            }
+            file << (x>left ? ",{" : "{") << tile->x << "," << tile->y << "}";
+        }
+        file << "\n";
+    }
+}
+
+int main(int argc, char* argv[]){
+
+    WorldOptions options = parseOptions(argc, argv);
+
+    // output paths are relative to where we were called from, tilesets to the project root
+    std::filesystem::path out = options.out.empty() ? options.out : std::filesystem::absolute(options.out);
+    std::filesystem::current_path(rootPath);
+    tilesetDir = options.tileset;
+
+    ChunkWorld world(loadRules(), options.chunkWidth, options.chunkHeight, options.seed, options.cache, options.propagation);
+
+    // walk in random directions, keeping every chunk within view in memory
+    Random walk(options.seed);
+    Point walker{0,0};
+    std::size_t peak{0};
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t step=0; step<=options.steps; step++){
+        if (step > 0){ walker += cardinals[walk.below(4)]; }
+
+        for (int y=-options.view; y<=options.view; y++){
+            for (int x=-options.view; x<=options.view; x++){
+                Point coord = walker + Point(x,y);
+                if (!world.chunk(coord)){
+                    std::cerr << "Chunk (" << coord.x << "," << coord.y << ") could not be collapsed in " << world.matcher.maxAttempts << " attempts, or connected to its neighbours.\n";
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+
+        peak = std::max(peak, world.size());
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (!out.empty()){ writeView(out, world, walker, options.view); }
+
+    std::cout << "tileset:          " << options.tileset << "\n"
+              << "chunk:            " << options.chunkWidth << "x" << options.chunkHeight << "\n"
+              << "end of walk:      (" << walker.x << "," << walker.y << ")\n"
+              << "chunks generated: " << world.generated << "\n"
+              << "chunks evicted:   " << world.evicted << "\n"
+              << "most in memory:   " << peak << "\n"
+              << "seam repairs:     " << world.repairs << "\n"
+              << "time (s):         " << elapsed.count() << "\n"
+              << "chunks/sec:       " << (elapsed.count() > 0.0 ? static_cast<double>(world.generated)/elapsed.count() : 0.0) << "\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include<cstddef>
+#include<cstdlib>
+#include<filesystem>
+#include<iostream>
+#include<memory>
+
+#include"analyzeTiles.h"
+#include"chunks.h"
+#include"compiledTiles.h"
+#include"globals.h"
+#include"point.h"
+#include"pool.h"
+#include"random.h"
+#include"tiled.h"
+
+// Every pair of tiles across the seams of tiled map pieces and world chunks must connect both ways. Checked
+// on campus, whose rules are one-sided, straight from compat rather than with the library's own seam checks.
+// Exits with failure on any seam which doesn't connect.
+
+// whether tile b may be in direction d of tile a, each allowing the other
+bool legal(const TileRules& rules, const tileState& a, std::size_t d, const tileState& b){
+    std::size_t i = rules.getIndex.at(a), j = rules.getIndex.at(b);
+    return rules.compat[d][i].test(j) && rules.compat[(d+2)%4][j].test(i);
+}
+
+// compat entries which the other tile does not allow back
+std::size_t oneSided(const TileRules& rules){
+
+    std::size_t count{0};
+    for (std::size_t d=0; d<4; d++){
+        for (std::size_t i=0; i<rules.uniqueTiles; i++){
+            rules.compat[d][i].forEach([&](std::size_t j){ count += !rules.compat[(d+2)%4][j].test(i); });
+        }
+    }
+    return count;
+}
+
+// pieces of 128x128 maps, every seam connecting once repaired
+std::size_t checkTiled(const std::shared_ptr<const TileRules>& rules){
+
+    std::size_t failures{0};
+
+    ThreadPool pool(4);
+    TiledGenerator generator(rules, pool);
+    TiledMap map(128, 128, 32, 32);
+
+    for (std::uint64_t seed=0; seed<10; seed++){
+
+        generator.generate(map, seed);
+        if (!map.solved){
+            std::cerr << "tiled seed " << seed << ": a piece could not be solved\n";
+            failures++;
+            continue;
+        }
+
+        std::size_t illegal{0};
+        for (int y=0; y<map.height; y++){
+            for (int x=0; x<map.width; x++){
+                if (x > 0 && x%map.pieceWidth == 0){ illegal += !legal(*rules, map.tileAt(x-1,y), 0, map.tileAt(x,y)); }
+                if (y > 0 && y%map.pieceHeight == 0){ illegal += !legal(*rules, map.tileAt(x,y-1), 1, map.tileAt(x,y)); }
+            }
+        }
+
+        if (illegal > 0 || map.unmatched > 0 || map.illegalSeams(*rules) > 0){
+            std::cerr << "tiled seed " << seed << ": " << illegal << " illegal seams, reported " << map.unmatched
+                      << " unmatched and " << map.illegalSeams(*rules) << " illegal\n";
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+// chunks of a random walk, every seam between chunks in memory connecting after each step
+// (repairs change the tiles of chunks generated before)
+std::size_t checkWorld(const std::shared_ptr<const TileRules>& rules){
+
+    ChunkWorld world(rules, 16, 16, 0, 64);
+    Random walk(0);
+    Point walker{0,0};
+
+    for (std::size_t step=0; step<=300; step++){
+        if (step > 0){ walker += cardinals[walk.below(4)]; }
+
+        for (int y=-1; y<=1; y++){
+            for (int x=-1; x<=1; x++){
+                if (!world.chunk(walker + Point(x,y))){
+                    std::cerr << "world: chunk (" << walker.x+x << "," << walker.y+y << ") could not be solved\n";
+                    return 1;
+                }
+            }
+        }
+
+        std::size_t illegal{0}, reported{0};
+        for (const Chunk& chunk : world.chunks){
+
+            reported += world.illegalSeams(chunk);
+
+            // cells whose next cell in direction d is in the neighbour
+            for (std::size_t d=0; d<4; d++){
+
+                const Chunk* neighbour = world.find(chunk.coord + cardinals[d]);
+                if (!neighbour){ continue; }
+
+                for (int cy=0; cy<world.chunkHeight; cy++){
+                    for (int cx=0; cx<world.chunkWidth; cx++){
+                        int nx = cx + cardinals[d].x, ny = cy + cardinals[d].y;
+                        if (nx>=0 && nx<world.chunkWidth && ny>=0 && ny<world.chunkHeight){ continue; }
+                        nx = (nx + world.chunkWidth)%world.chunkWidth;
+                        ny = (ny + world.chunkHeight)%world.chunkHeight;
+                        illegal += !legal(*rules, chunk.tiles[static_cast<std::size_t>(cy*world.chunkWidth + cx)], d,
+                                          neighbour->tiles[static_cast<std::size_t>(ny*world.chunkWidth + nx)]);
+                    }
+                }
+            }
+        }
+
+        if (illegal > 0 || reported > 0){
+            std::cerr << "world step " << step << ": " << illegal << " illegal seams, reported " << reported << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(){
+
+    std::filesystem::current_path(rootPath);
+    tilesetDir = "campus";
+    std::shared_ptr<const TileRules> rules = loadRules();
+
+    std::size_t failures{0};
+
+    if (oneSided(*rules) == 0){
+        std::cerr << "campus has no one-sided rules, the seams are not tested against them\n";
+        failures++;
+    }
+
+    failures += checkTiled(rules);
+    failures += checkWorld(rules);
+
+    if (failures > 0){
+        std::cerr << failures << " failed\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "every seam connects\n";
+    return EXIT_SUCCESS;
+}